@@ -27,15 +27,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
 
+#define _GNU_SOURCE
+
 #include <mpi.h>
 #include <omp.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include "my_stream_nt.h"
+#include "my_stream_perf.h"
 #include "my_stream_utils.h"
 
 #define DEFAULT_TEST_SIZE 50000000
@@ -54,6 +60,9 @@ struct stream_results {
   double bandwidth;
   double consume_out;
   double total_streamed_memory;
+
+  /* counters of the measured repetitions, with --perf */
+  struct perf_values perf;
 };
 
 struct stream_results make_stream_results() {
@@ -63,6 +72,7 @@ struct stream_results make_stream_results() {
   results.bandwidth = 0.0;
   results.consume_out = 0.0;
   results.total_streamed_memory = 0.0;
+  memset(&results.perf, 0, sizeof(struct perf_values));
 
   return results;
 }
@@ -71,6 +81,8 @@ struct streams_args {
   size_t size;
   size_t vec_size_proc;
   size_t benchmark_repetitions;
+  int warmup;
+  int nt_store;
 
   struct stream_results FMA;
   struct stream_results copy;
@@ -86,6 +98,8 @@ struct streams_args make_stream_args(const size_t size,                    //
   args.size = size;
   args.vec_size_proc = vec_size_proc;
   args.benchmark_repetitions = benchmark_repetitions;
+  args.warmup = 0;
+  args.nt_store = 0;
 
   args.FMA = make_stream_results();
   args.copy = make_stream_results();
@@ -95,10 +109,125 @@ struct streams_args make_stream_args(const size_t size,                    //
   return args;
 }
 
+/**
+ * @brief Committed datatype of struct streams_args, so that the results of the
+ * ranks are gathered field by field and not as raw bytes.
+ *
+ * @return MPI_Datatype to be released with MPI_Type_free
+ */
+MPI_Datatype make_stream_args_type(void) {
+
+  const MPI_Datatype size_type = sizeof(size_t) == sizeof(unsigned long)
+                                     ? MPI_UNSIGNED_LONG
+                                     : MPI_UNSIGNED;
+
+  int results_lengths[6] = {1, 1, 1, 1, PERF_NR_EVENTS, 1};
+  MPI_Aint results_offsets[6] = {
+      offsetof(struct stream_results, clock),
+      offsetof(struct stream_results, bandwidth),
+      offsetof(struct stream_results, consume_out),
+      offsetof(struct stream_results, total_streamed_memory),
+      offsetof(struct stream_results, perf.count),
+      offsetof(struct stream_results, perf.imc_bytes)};
+  MPI_Datatype results_types[6] = {MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE,
+                                   MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE};
+
+  MPI_Datatype results_struct, results_type;
+  MPI_Type_create_struct(6, results_lengths, results_offsets, results_types,
+                         &results_struct);
+  MPI_Type_create_resized(results_struct, 0, sizeof(struct stream_results),
+                          &results_type);
+
+  int args_lengths[9] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
+  MPI_Aint args_offsets[9] = {
+      offsetof(struct streams_args, size),
+      offsetof(struct streams_args, vec_size_proc),
+      offsetof(struct streams_args, benchmark_repetitions),
+      offsetof(struct streams_args, warmup),
+      offsetof(struct streams_args, nt_store),
+      offsetof(struct streams_args, FMA),
+      offsetof(struct streams_args, copy),
+      offsetof(struct streams_args, axpy),
+      offsetof(struct streams_args, add_mul)};
+  MPI_Datatype args_types[9] = {size_type,    size_type,    size_type,
+                                MPI_INT,      MPI_INT,      results_type,
+                                results_type, results_type, results_type};
+
+  MPI_Datatype args_struct, args_type;
+  MPI_Type_create_struct(9, args_lengths, args_offsets, args_types,
+                         &args_struct);
+  // the extent of the C struct, trailing padding included, for the arrays
+  MPI_Type_create_resized(args_struct, 0, sizeof(struct streams_args),
+                          &args_type);
+  MPI_Type_commit(&args_type);
+
+  MPI_Type_free(&args_struct);
+  MPI_Type_free(&results_type);
+  MPI_Type_free(&results_struct);
+
+  return args_type;
+}
+
+/* NUMA node of the vectors, -1 for the default allocation */
+int mem_node = -1;
+
+/* pages backing the vectors, one of PAGES_* */
+int page_mode = PAGES_DEFAULT;
+
+/* OpenMP threads of each rank, more than one in the hybrid mode */
+int omp_threads = 1;
+
 void *stream_calloc(size_t __alignment, size_t vector_len, size_t type_size) {
+  if (mem_node >= 0 || page_mode != PAGES_DEFAULT) {
+    void *ptr = stream_mmap_alloc(vector_len * type_size, mem_node,
+                                  page_mode);
+    if (ptr == NULL) {
+      printf("Error: cannot allocate the vectors (NUMA node %d, %s pages)\n",
+             mem_node, page_mode_name(page_mode));
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return ptr;
+  }
   return (void *)aligned_alloc(__alignment, vector_len * type_size);
 }
 
+void stream_free(void *ptr) {
+  if (!stream_mmap_free(ptr)) {
+    free(ptr);
+  }
+}
+
+/**
+ * @brief Opens the counters of the threads of the rank, before the barrier.
+ */
+void perf_team_open(void) {
+#pragma omp parallel if (omp_threads > 1)
+  { perf_thread_open(); }
+}
+
+/**
+ * @brief Enables the counters of the threads of the rank, after the barrier.
+ */
+void perf_team_start(void) {
+#pragma omp parallel if (omp_threads > 1)
+  { perf_thread_start(); }
+}
+
+/**
+ * @brief Adds the counters of the threads of the rank to acc.
+ *
+ * @param acc
+ */
+void perf_team_stop(struct perf_values *acc) {
+#pragma omp parallel if (omp_threads > 1)
+  {
+    struct perf_values v = {{0}};
+    perf_thread_stop(&v);
+#pragma omp critical
+    perf_values_add(acc, &v);
+  }
+}
+
 typedef float_type vector_type
     __attribute__((vector_size(VECTOR_LEN * sizeof(float_type)), //
                    aligned(sizeof(float_type))));                //
@@ -111,9 +240,10 @@ typedef float_type vector_type
  * @param c
  * @param d
  * @param args
+ * @param clocks time of each repetition, warm-up included
  */
 void FMA_test(float_type *a, float_type *b, float_type *c, float_type *d,
-              struct streams_args *args) {
+              struct streams_args *args, double *clocks) {
 
   vector_type *a_vec = (vector_type *)(a);
   vector_type *b_vec = (vector_type *)(b);
@@ -126,18 +256,42 @@ void FMA_test(float_type *a, float_type *b, float_type *c, float_type *d,
 
   struct timespec start, end;
 
-  for (int r = 0; r < args->benchmark_repetitions; r++) {
+  for (int r = 0; r < args->warmup + args->benchmark_repetitions; r++) {
+    struct perf_values warmup_perf = {{0}};
+    struct perf_values *perf =
+        r < args->warmup ? &warmup_perf : &args->FMA.perf;
+
+    perf_imc_start();
+    perf_team_open();
     MPI_Barrier(MPI_COMM_WORLD);
 
+    perf_team_start();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < size_vec; i++) {
-      d_vec[i] = a_vec[i] * b_vec[i] + c_vec[i];
+    if (args->nt_store) {
+#pragma omp parallel if (omp_threads > 1)
+      {
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < size_vec; i++) {
+          stream_nt_store(&d[i * VECTOR_LEN], a_vec[i] * b_vec[i] + c_vec[i]);
+        }
+        stream_nt_fence();
+      }
+    } else {
+#pragma omp parallel for schedule(static) if (omp_threads > 1)
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i] * b_vec[i] + c_vec[i];
+      }
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_team_stop(perf);
 
     MPI_Barrier(MPI_COMM_WORLD);
+    perf_imc_stop(perf);
 
-    args->FMA.clock += get_time(start, end);
+    clocks[r] = get_time(start, end);
+    if (r >= args->warmup) {
+      args->FMA.clock += clocks[r];
+    }
     consume +=
         d[rand() % args->vec_size_proc] + a[rand() % args->vec_size_proc] +
         b[rand() % args->vec_size_proc] + c[rand() % args->vec_size_proc];
@@ -159,9 +313,10 @@ void FMA_test(float_type *a, float_type *b, float_type *c, float_type *d,
  * @param c
  * @param d
  * @param args
+ * @param clocks time of each repetition, warm-up included
  */
 void copy_test(float_type *a, float_type *b, float_type *c, float_type *d,
-               struct streams_args *args) {
+               struct streams_args *args, double *clocks) {
 
   vector_type *a_vec = (vector_type *)(a);
   vector_type *d_vec = (vector_type *)(d);
@@ -171,18 +326,42 @@ void copy_test(float_type *a, float_type *b, float_type *c, float_type *d,
   float_type consume = 0;
   struct timespec start, end;
 
-  for (int r = 0; r < args->benchmark_repetitions; r++) {
+  for (int r = 0; r < args->warmup + args->benchmark_repetitions; r++) {
+    struct perf_values warmup_perf = {{0}};
+    struct perf_values *perf =
+        r < args->warmup ? &warmup_perf : &args->copy.perf;
+
+    perf_imc_start();
+    perf_team_open();
     MPI_Barrier(MPI_COMM_WORLD);
 
+    perf_team_start();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < size_vec; i++) {
-      d_vec[i] = a_vec[i];
+    if (args->nt_store) {
+#pragma omp parallel if (omp_threads > 1)
+      {
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < size_vec; i++) {
+          stream_nt_store(&d[i * VECTOR_LEN], a_vec[i]);
+        }
+        stream_nt_fence();
+      }
+    } else {
+#pragma omp parallel for schedule(static) if (omp_threads > 1)
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i];
+      }
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_team_stop(perf);
 
     MPI_Barrier(MPI_COMM_WORLD);
+    perf_imc_stop(perf);
 
-    args->copy.clock += get_time(start, end);
+    clocks[r] = get_time(start, end);
+    if (r >= args->warmup) {
+      args->copy.clock += clocks[r];
+    }
     consume +=
         d[rand() % args->vec_size_proc] + a[rand() % args->vec_size_proc];
   }
@@ -205,9 +384,10 @@ void copy_test(float_type *a, float_type *b, float_type *c, float_type *d,
  * @param c
  * @param d
  * @param args
+ * @param clocks time of each repetition, warm-up included
  */
 void axpy_test(float_type *a, float_type *b, float_type *c, float_type *d,
-               struct streams_args *args) {
+               struct streams_args *args, double *clocks) {
 
   vector_type *a_vec = (vector_type *)(a);
   vector_type *b_vec = (vector_type *)(b);
@@ -221,18 +401,42 @@ void axpy_test(float_type *a, float_type *b, float_type *c, float_type *d,
 
   struct timespec start, end;
 
-  for (int r = 0; r < args->benchmark_repetitions; r++) {
+  for (int r = 0; r < args->warmup + args->benchmark_repetitions; r++) {
+    struct perf_values warmup_perf = {{0}};
+    struct perf_values *perf =
+        r < args->warmup ? &warmup_perf : &args->axpy.perf;
+
+    perf_imc_start();
+    perf_team_open();
     MPI_Barrier(MPI_COMM_WORLD);
 
+    perf_team_start();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < size_vec; i++) {
-      d_vec[i] = alpha * a_vec[i] + b_vec[i];
+    if (args->nt_store) {
+#pragma omp parallel if (omp_threads > 1)
+      {
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < size_vec; i++) {
+          stream_nt_store(&d[i * VECTOR_LEN], alpha * a_vec[i] + b_vec[i]);
+        }
+        stream_nt_fence();
+      }
+    } else {
+#pragma omp parallel for schedule(static) if (omp_threads > 1)
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = alpha * a_vec[i] + b_vec[i];
+      }
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_team_stop(perf);
 
     MPI_Barrier(MPI_COMM_WORLD);
+    perf_imc_stop(perf);
 
-    args->axpy.clock += get_time(start, end);
+    clocks[r] = get_time(start, end);
+    if (r >= args->warmup) {
+      args->axpy.clock += clocks[r];
+    }
     consume += d[rand() % args->vec_size_proc] +
                a[rand() % args->vec_size_proc] +
                c[rand() % args->vec_size_proc];
@@ -254,9 +458,10 @@ void axpy_test(float_type *a, float_type *b, float_type *c, float_type *d,
  * @param c
  * @param d
  * @param args
+ * @param clocks time of each repetition, warm-up included
  */
 void add_mul_test(float_type *a, float_type *b, float_type *c, float_type *d,
-                  struct streams_args *args) {
+                  struct streams_args *args, double *clocks) {
 
   vector_type *a_vec = (vector_type *)(a);
   vector_type *b_vec = (vector_type *)(b);
@@ -269,19 +474,44 @@ void add_mul_test(float_type *a, float_type *b, float_type *c, float_type *d,
 
   struct timespec start, end;
 
-  for (int r = 0; r < args->benchmark_repetitions; r++) {
+  for (int r = 0; r < args->warmup + args->benchmark_repetitions; r++) {
+    struct perf_values warmup_perf = {{0}};
+    struct perf_values *perf =
+        r < args->warmup ? &warmup_perf : &args->add_mul.perf;
+
+    perf_imc_start();
+    perf_team_open();
     MPI_Barrier(MPI_COMM_WORLD);
 
+    perf_team_start();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < size_vec; i++) {
-      d_vec[i] = a_vec[i] + b_vec[i];
-      c_vec[i] = a_vec[i] * b_vec[i];
+    if (args->nt_store) {
+#pragma omp parallel if (omp_threads > 1)
+      {
+#pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < size_vec; i++) {
+          stream_nt_store(&d[i * VECTOR_LEN], a_vec[i] + b_vec[i]);
+          stream_nt_store(&c[i * VECTOR_LEN], a_vec[i] * b_vec[i]);
+        }
+        stream_nt_fence();
+      }
+    } else {
+#pragma omp parallel for schedule(static) if (omp_threads > 1)
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i] + b_vec[i];
+        c_vec[i] = a_vec[i] * b_vec[i];
+      }
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_team_stop(perf);
 
     MPI_Barrier(MPI_COMM_WORLD);
+    perf_imc_stop(perf);
 
-    args->add_mul.clock += get_time(start, end);
+    clocks[r] = get_time(start, end);
+    if (r >= args->warmup) {
+      args->add_mul.clock += clocks[r];
+    }
     consume +=
         d[rand() % args->vec_size_proc] + a[rand() % args->vec_size_proc] +
         b[rand() % args->vec_size_proc] + c[rand() % args->vec_size_proc];
@@ -298,10 +528,353 @@ void add_mul_test(float_type *a, float_type *b, float_type *c, float_type *d,
 #define HLINE                                                                  \
   "------------------------------------------------------------------\n"
 
+/**
+ * @brief RandomAccess (GUPS): every rank XOR-updates random entries of its own
+ * table, the tables of the ranks of a node share table_bytes. One update per
+ * entry per repetition, with 1, 2, 4 ... 64 updates in flight. The rate is
+ * the sum of the updates over the slowest rank.
+ *
+ * @param table_bytes per node
+ * @param node_size ranks on the node of this rank
+ * @param benchmark_repetitions
+ * @param warmup
+ */
+void gups_test(const size_t table_bytes, const int node_size,
+               const int benchmark_repetitions, const int warmup) {
+
+  int rank, world_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+  const int table_bits = gups_table_bits(table_bytes / node_size);
+  const size_t entries = (size_t)1 << table_bits;
+
+  uint64_t *table =
+      (uint64_t *)stream_calloc(64, entries, sizeof(uint64_t));
+  for (size_t i = 0; i < entries; i++) {
+    table[i] = i;
+  }
+
+  if (rank == 0) {
+    printf("RandomAccess (GUPS), %d ranks, table of %.1f MiB per rank\n",
+           world_size, entries * sizeof(uint64_t) / to_MB);
+    printf(HLINE);
+    printf("In flight          GUP/s     ns per update per rank\n");
+    printf(HLINE);
+  }
+
+  for (int batch = 1; batch <= GUPS_MAX_BATCH; batch *= 2) {
+    double max_time = 0.0;
+
+    for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+      struct timespec start, end;
+
+      MPI_Barrier(MPI_COMM_WORLD);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      gups_update(table, table_bits, entries, batch, rank);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      double time = get_time(start, end);
+      double slowest = 0.0;
+      MPI_Reduce(&time, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+      if (r >= warmup) {
+        max_time += slowest;
+      }
+    }
+    max_time /= benchmark_repetitions;
+
+    if (rank == 0) {
+      const double updates = (double)(entries / batch * batch);
+      printf("%9d  %13.4f  %25.2f\n", batch,
+             updates * world_size / max_time / 1.0e6,
+             max_time * 1.0e6 / updates);
+      fflush(stdout);
+    }
+  }
+
+  if (rank == 0) {
+    printf(HLINE);
+    printf("consume %lu (just an output)\n\n", table[entries / 3]);
+  }
+
+  stream_free(table);
+}
+
+/**
+ * @brief Shared memory window mode: the vectors of the ranks of a node are
+ * the segments of a window allocated with MPI_Win_allocate_shared, each
+ * first touched by its owner. Every rank then runs the kernels with load and
+ * store on its own segment, on the segment of the next rank, and on the
+ * segment of a rank on another NUMA node, shifted the same way for all the
+ * ranks so that each segment is streamed by one rank. No message is sent.
+ * The rate is the sum of the bytes over the slowest rank.
+ *
+ * @param vec_size_proc elements of each vector of a rank
+ * @param node_comm ranks of the node
+ * @param benchmark_repetitions
+ * @param warmup
+ */
+void shared_window_test(const size_t vec_size_proc, MPI_Comm node_comm,
+                        const int benchmark_repetitions, const int warmup) {
+
+  int rank, world_size, node_rank, node_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_size(node_comm, &node_size);
+
+  // the segments can be placed apart, on the NUMA node of their owner
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "alloc_shared_noncontig", "true");
+
+  float_type *base;
+  MPI_Win win;
+  MPI_Win_allocate_shared(4 * vec_size_proc * sizeof(float_type),
+                          sizeof(float_type), info, node_comm, &base, &win);
+  MPI_Info_free(&info);
+
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+
+  unsigned int r = 1;
+  for (size_t i = 0; i < vec_size_proc; i++) {
+    r = generate_random_number(r);
+    base[i] = 1.0 + (float_type)(r % 300) / 200.0;
+    base[vec_size_proc + i] = 1.0 + (float_type)(r % 400) / 300.0;
+    base[2 * vec_size_proc + i] = 1.0 + (float_type)(r % 500) / 300.0;
+    base[3 * vec_size_proc + i] = 0.0;
+  }
+
+  // the NUMA node of every rank of the node, to find a remote segment
+  const int numa_node = cpu_to_numa_node(sched_getcpu());
+  int *numa_nodes = malloc(node_size * sizeof(int));
+  MPI_Allgather(&numa_node, 1, MPI_INT, numa_nodes, 1, MPI_INT, node_comm);
+
+  // every rank must run the same number of collectives, and a shift of
+  // node_size or more would wrap back to the own segment of a rank
+  int min_node_size;
+  MPI_Allreduce(&node_size, &min_node_size, 1, MPI_INT, MPI_MIN,
+                MPI_COMM_WORLD);
+
+  // smallest shift which moves every rank to another NUMA node, on all nodes
+  int remote_shift = 0;
+  for (int s = 1; s < min_node_size; s++) {
+    int remote = numa_nodes[(node_rank + s) % node_size] != numa_node;
+    int all_remote;
+    MPI_Allreduce(&remote, &all_remote, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (all_remote) {
+      remote_shift = s;
+      break;
+    }
+  }
+  free(numa_nodes);
+
+  if (rank == 0) {
+    printf("Shared window (MPI_Win_allocate_shared), %d ranks, %.1f MiB per "
+           "segment [GB/s]:\n",
+           world_size, 4 * vec_size_proc * sizeof(float_type) / to_MB);
+    printf(HLINE);
+    printf("Segment             Shift      axpy      copy       FMA   "
+           "add mul\n");
+    printf(HLINE);
+  }
+
+  const char *names[3] = {"own", "next rank", "other NUMA node"};
+  const int shifts[3] = {0, min_node_size > 1 ? 1 : -1,
+                         remote_shift > 0 ? remote_shift : -1};
+
+  const int total_repetitions = warmup + benchmark_repetitions;
+  double *clocks = malloc(4 * total_repetitions * sizeof(double));
+  float_type consume = 0.0;
+
+  for (int t = 0; t < 3; t++) {
+    if (shifts[t] < 0) {
+      if (rank == 0) {
+        printf("%-16s  %7s  %s\n", names[t], "-",
+               t == 1 ? "n/a, one rank per node" : "n/a, one NUMA node");
+      }
+      continue;
+    }
+
+    MPI_Aint segment_size;
+    int disp_unit;
+    float_type *segment;
+    MPI_Win_shared_query(win, (node_rank + shifts[t]) % node_size,
+                         &segment_size, &disp_unit, &segment);
+
+    float_type *a = segment;
+    float_type *b = segment + vec_size_proc;
+    float_type *c = segment + 2 * vec_size_proc;
+    float_type *d = segment + 3 * vec_size_proc;
+
+    // the stores of the previous kernels are visible to all the ranks
+    MPI_Win_sync(win);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(win);
+
+    struct streams_args args =
+        make_stream_args(vec_size_proc, vec_size_proc, benchmark_repetitions);
+    args.warmup = warmup;
+
+    axpy_test(a, b, c, d, &args, clocks);
+    copy_test(a, b, c, d, &args, clocks + total_repetitions);
+    FMA_test(a, b, c, d, &args, clocks + 2 * total_repetitions);
+    add_mul_test(a, b, c, d, &args, clocks + 3 * total_repetitions);
+
+    consume += args.axpy.consume_out + args.copy.consume_out +
+               args.FMA.consume_out + args.add_mul.consume_out;
+
+    const double clock[4] = {args.axpy.clock, args.copy.clock, args.FMA.clock,
+                             args.add_mul.clock};
+    const int nr_streams[4] = {3, 2, 4, 4};
+    double slowest[4];
+    MPI_Reduce(clock, slowest, 4, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+      printf("%-16s  %+7d", names[t], shifts[t]);
+      for (int k = 0; k < 4; k++) {
+        printf("  %8.3f",
+               compute_bandwidth(world_size, nr_streams[k], vec_size_proc,
+                                 slowest[k], sizeof(float_type)) /
+                   to_GB);
+      }
+      printf("\n");
+      fflush(stdout);
+    }
+  }
+
+  if (rank == 0) {
+    printf(HLINE);
+    printf("consume %f (just an output)\n\n", consume);
+  }
+
+  free(clocks);
+
+  MPI_Win_unlock_all(win);
+  MPI_Win_free(&win);
+}
+
+/**
+ * @brief Mean over the measured repetitions of the time of the slowest rank,
+ * the window in which all the selected ranks streamed.
+ *
+ * @param samples one row per rank
+ * @param rank_node node of each rank
+ * @param node only the ranks of this node, -1 for all the ranks
+ * @return double
+ */
+double slowest_rank_time(const struct stream_samples *samples,
+                         const int *rank_node, const int node) {
+
+  double total = 0.0;
+
+  for (int r = samples->warmup; r < samples->nr_repetitions; r++) {
+    double slowest = 0.0;
+    for (int i = 0; i < samples->nr_threads; i++) {
+      const double t = samples->clock[i * samples->nr_repetitions + r];
+      if ((node < 0 || rank_node[i] == node) && t > slowest) {
+        slowest = t;
+      }
+    }
+    total += slowest;
+  }
+
+  return total / (samples->nr_repetitions - samples->warmup);
+}
+
+/**
+ * @brief
+ *
+ * @param samples one row per rank
+ * @param rank
+ * @return double mean time of the measured repetitions of the rank
+ */
+double rank_mean_time(const struct stream_samples *samples, const int rank) {
+
+  double total = 0.0;
+  for (int r = samples->warmup; r < samples->nr_repetitions; r++) {
+    total += samples->clock[rank * samples->nr_repetitions + r];
+  }
+
+  return total / (samples->nr_repetitions - samples->warmup);
+}
+
+/**
+ * @brief Prints, for each node, the bytes of its ranks over the time of its
+ * slowest rank, the slowest rank and the imbalance (mean time of the slowest
+ * rank over the fastest one). The last row covers all the ranks, its
+ * bandwidth is the true aggregate.
+ *
+ * @param id name of the kernel
+ * @param samples one row per rank
+ * @param rank_node node of each rank
+ * @param hosts processor name of each rank, MPI_MAX_PROCESSOR_NAME apart
+ * @param nr_nodes
+ * @param rank_bytes bytes streamed by a rank in a repetition
+ */
+void print_node_breakdown(const char *id, const struct stream_samples *samples,
+                          const int *rank_node, const char *hosts,
+                          const int nr_nodes, const double rank_bytes) {
+
+  printf("Per node, %s [GB/s over the slowest rank of the node]:\n", id);
+  printf(HLINE);
+  printf("Node  Host              Ranks      GB/s  Slowest rank  Imbalance\n");
+  printf(HLINE);
+
+  for (int node = 0; node <= nr_nodes; node++) {
+    const int selected = node < nr_nodes ? node : -1;
+
+    int nr_ranks = 0;
+    int slowest = 0;
+    double max_time = 0.0;
+    double min_time = 0.0;
+    const char *host = "";
+
+    for (int i = 0; i < samples->nr_threads; i++) {
+      if (selected >= 0 && rank_node[i] != selected) {
+        continue;
+      }
+
+      const double t = rank_mean_time(samples, i);
+      if (nr_ranks == 0) {
+        host = &hosts[i * MPI_MAX_PROCESSOR_NAME];
+        min_time = t;
+      }
+      if (t > max_time) {
+        max_time = t;
+        slowest = i;
+      }
+      if (t < min_time) {
+        min_time = t;
+      }
+      nr_ranks++;
+    }
+
+    const double bandwidth =
+        nr_ranks * rank_bytes /
+        (slowest_rank_time(samples, rank_node, selected) / 1000.0) / to_GB;
+
+    if (selected < 0) {
+      printf(HLINE);
+      printf("All   %-16s", "");
+    } else {
+      printf("%4d  %-16.16s", node, host);
+    }
+    printf("  %5d  %8.3f  %12d  %8.1f%%\n", nr_ranks, bandwidth, slowest,
+           100.0 * (max_time / min_time - 1.0));
+  }
+
+  printf(HLINE);
+  printf("\n");
+}
+
 int main(int argc, char **argv) {
 
-  // Init mpi
-  MPI_Init(&argc, &argv);
+  // Init mpi, only the main thread of a rank calls MPI (hybrid mode)
+  int thread_support;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
   int world_size;
   MPI_Comm_size(MPI_COMM_WORLD, &world_size);
 
@@ -309,6 +882,50 @@ int main(int argc, char **argv) {
   int rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+  // opened first: with csv or json on stdout the report moves to stderr
+  const char *oi =
+      find_command_line_arg_value(argc, (const char **)argv, "--output");
+  const int output_format = parse_output_format(oi);
+
+  if (output_format < 0) {
+    if (rank == 0)
+      printf("Error: --output must be text, csv or json\n");
+
+    MPI_Finalize();
+    return 1;
+  }
+
+  // the records of --output describe the default kernels only
+  if (output_format != OUTPUT_TEXT &&
+      (flag_exists(argc, (const char **)argv, "--gups") ||
+       flag_exists(argc, (const char **)argv, "--shared-window"))) {
+    if (rank == 0)
+      printf("Error: --output csv|json reports the default kernels, it "
+             "cannot be combined with --gups or --shared-window\n");
+
+    MPI_Finalize();
+    return 1;
+  }
+
+  FILE *results_out = NULL;
+  int output_error = 0;
+
+  if (rank == 0) {
+    const char *fi = find_command_line_arg_value(argc, (const char **)argv,
+                                                  "--output-file");
+    results_out = results_output_open(output_format, fi);
+    output_error = output_format != OUTPUT_TEXT && results_out == NULL;
+  }
+  MPI_Bcast(&output_error, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  if (output_error) {
+    if (rank == 0)
+      printf("Error: cannot open the --output-file\n");
+
+    MPI_Finalize();
+    return 1;
+  }
+
   if (rank == 0) {
     printf("\n");
     printf(HLINE);
@@ -338,6 +955,32 @@ int main(int argc, char **argv) {
       printf("  -s SIZE                     Size of the vector.\n");
       printf("  -r REPETITIONS              Number of repetitions of each "
              "benchmark.\n");
+      printf(BIND_POLICY_HELP);
+      printf("                              Applied to the ranks of each node, "
+             "default: none.\n");
+      printf(MEMBIND_HELP);
+      printf(PAGES_HELP);
+      printf(STORE_HELP);
+      printf(WARMUP_HELP);
+      printf(OUTPUT_HELP);
+      printf(PERF_HELP);
+      printf(GUPS_HELP);
+      printf("  --shared-window             Stream the own segment, the next "
+             "rank's and one on\n"
+             "                              another NUMA node of a window "
+             "shared by the ranks\n"
+             "                              of a node "
+             "(MPI_Win_allocate_shared).\n");
+      printf("  --omp-threads N             Hybrid mode: each rank runs the "
+             "kernels with N\n"
+             "                              OpenMP threads over its slice, "
+             "default 1.\n");
+      printf("  --init MODE                 parallel: each rank first touches "
+             "its own vectors\n"
+             "                              (default), serial: the pages of "
+             "a node are\n"
+             "                              placed on the NUMA node of its "
+             "first rank.\n");
 
       printf("\n");
       printf("Description:\n");
@@ -356,13 +999,13 @@ int main(int argc, char **argv) {
     return 0;
   }
 
-  const int ai =
-      find_command_line_arg_value_v2(argc, (const char **)argv, "-s");
+  const char *ai =
+      find_command_line_arg_value(argc, (const char **)argv, "-s");
 
-  if (ai > 0) {
+  if (ai != NULL) {
 
-    if (is_number(argv[ai])) {
-      vec_size = strtoul(argv[ai], NULL, 10);
+    if (is_number(ai)) {
+      vec_size = strtoul(ai, NULL, 10);
       if (rank == 0)
         printf("User defined vector size: %lu\n", vec_size);
 
@@ -376,12 +1019,12 @@ int main(int argc, char **argv) {
     }
   }
 
-  const int ri =
-      find_command_line_arg_value_v2(argc, (const char **)argv, "-r");
+  const char *ri =
+      find_command_line_arg_value(argc, (const char **)argv, "-r");
 
-  if (ri > 0) {
-    if (is_number(argv[ri])) {
-      benchmark_repetitions = atoi(argv[ri]);
+  if (ri != NULL) {
+    if (is_number(ri)) {
+      benchmark_repetitions = atoi(ri);
       if (rank == 0)
         printf("User defined benchmark repetitions: %d\n",
                benchmark_repetitions);
@@ -394,6 +1037,216 @@ int main(int argc, char **argv) {
     }
   }
 
+  const char *si =
+      find_command_line_arg_value(argc, (const char **)argv, "--store");
+  const int store_mode = parse_store_mode(si);
+
+  if (store_mode == 0) {
+    if (rank == 0)
+      printf("Error: --store must be regular, nt or both\n");
+
+    MPI_Finalize();
+    return 1;
+  }
+
+  int warmup = DEFAULT_WARMUP;
+  const char *wi =
+      find_command_line_arg_value(argc, (const char **)argv, "--warmup");
+
+  if (wi != NULL) {
+    if (is_number(wi)) {
+      warmup = atoi(wi);
+    } else {
+      if (rank == 0)
+        printf("Error: argument of --warmup is not numeric\n");
+
+      MPI_Finalize();
+      return 1;
+    }
+  }
+
+  const char *pi =
+      find_command_line_arg_value(argc, (const char **)argv, "--pages");
+  page_mode = parse_page_mode(pi);
+
+  if (page_mode < 0) {
+    if (rank == 0)
+      printf("Error: --pages must be 4k, thp, 2m or 1g\n");
+
+    MPI_Finalize();
+    return 1;
+  }
+
+  const char *mi =
+      find_command_line_arg_value(argc, (const char **)argv, "--membind");
+
+  if (mi != NULL) {
+    if (is_number(mi)) {
+      mem_node = atoi(mi);
+      if (rank == 0)
+        printf("User defined NUMA node of the vectors: %d\n", mem_node);
+    } else {
+      if (rank == 0)
+        printf("Error: argument of --membind is not numeric\n");
+
+      MPI_Finalize();
+      return 1;
+    }
+  }
+
+  const char *oti =
+      find_command_line_arg_value(argc, (const char **)argv,
+                                     "--omp-threads");
+
+  if (oti != NULL) {
+    if (!is_number(oti) || atoi(oti) < 1) {
+      if (rank == 0)
+        printf("Error: argument of --omp-threads must be a positive number\n");
+
+      MPI_Finalize();
+      return 1;
+    }
+    omp_threads = atoi(oti);
+  }
+
+  if (omp_threads > 1 && thread_support < MPI_THREAD_FUNNELED) {
+    if (rank == 0)
+      printf("Error: the MPI library does not support threads "
+             "(MPI_THREAD_FUNNELED)\n");
+
+    MPI_Finalize();
+    return 1;
+  }
+  omp_set_num_threads(omp_threads);
+
+  // the binding is applied to the threads of the ranks sharing the same node
+  MPI_Comm node_comm;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank,
+                      MPI_INFO_NULL, &node_comm);
+
+  int node_rank, node_size;
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_size(node_comm, &node_size);
+
+  const char *bind_policy =
+      find_command_line_arg_value(argc, (const char **)argv, "--bind");
+
+  int *rank_cpus = make_cpu_binding(bind_policy, node_size * omp_threads);
+  int bind_error = rank_cpus == NULL;
+
+  // consecutive CPUs of the policy for the threads of a rank
+  if (rank_cpus != NULL) {
+#pragma omp parallel if (omp_threads > 1) reduction(| : bind_error)
+    bind_error |= bind_thread_to_cpu(
+                      pthread_self(),
+                      rank_cpus[node_rank * omp_threads +
+                                omp_get_thread_num()]) != 0;
+  }
+
+  // the affinity masks may differ between the ranks, all of them must stop
+  int any_bind_error;
+  MPI_Allreduce(&bind_error, &any_bind_error, 1, MPI_INT, MPI_MAX,
+                MPI_COMM_WORLD);
+  if (any_bind_error) {
+    if (rank == 0)
+      printf("Error: invalid --bind policy %s, a CPU not allowed or fewer "
+             "CPUs than the %d threads of a node\n",
+             bind_policy, node_size * omp_threads);
+
+    free(rank_cpus);
+    MPI_Finalize();
+    return 1;
+  }
+
+  // the memory controllers are counted once per node, by its first rank
+  if (flag_exists(argc, (const char **)argv, "--perf") &&
+      perf_init(rank == 0)) {
+    const int nr_imc = node_rank == 0 ? perf_imc_open() : 0;
+    if (rank == 0) {
+      printf("IMC counters (rank 0 node): %d\n\n", nr_imc);
+    }
+  }
+
+  if (flag_exists(argc, (const char **)argv, "--gups")) {
+    // default: the footprint of the four vectors of the ranks of the node
+    size_t gups_bytes = 4 * (vec_size / world_size) * sizeof(float_type) *
+                        node_size;
+
+    const char *gi =
+        find_command_line_arg_value(argc, (const char **)argv,
+                                       "--gups-size");
+    if (gi != NULL) {
+      if (!is_number(gi)) {
+        if (rank == 0)
+          printf("Error: argument of --gups-size is not numeric\n");
+
+        MPI_Finalize();
+        return 1;
+      }
+      gups_bytes = strtoul(gi, NULL, 10);
+    }
+
+    gups_test(gups_bytes, node_size, benchmark_repetitions, warmup);
+
+    free(rank_cpus);
+    MPI_Comm_free(&node_comm);
+    MPI_Finalize();
+    return 0;
+  }
+
+  if (flag_exists(argc, (const char **)argv, "--shared-window")) {
+    size_t vec_size_proc = vec_size / world_size;
+    vec_size_proc = (vec_size_proc - vec_size_proc % VECTOR_LEN) + VECTOR_LEN;
+
+    shared_window_test(vec_size_proc, node_comm, benchmark_repetitions,
+                       warmup);
+
+    free(rank_cpus);
+    MPI_Comm_free(&node_comm);
+    MPI_Finalize();
+    return 0;
+  }
+
+  const char *ii =
+      find_command_line_arg_value(argc, (const char **)argv, "--init");
+  const int serial_init = ii != NULL && strcmp(ii, "serial") == 0;
+
+  if (ii != NULL && !serial_init && strcmp(ii, "parallel") != 0) {
+    if (rank == 0)
+      printf("Error: --init must be serial or parallel\n");
+
+    MPI_Finalize();
+    return 1;
+  }
+
+  // node of each rank on rank 0, numbered in the order of their first rank
+  // (the lowest world rank of a node is its rank 0 in node_comm)
+  int node_leader = rank;
+  MPI_Bcast(&node_leader, 1, MPI_INT, 0, node_comm);
+
+  char host[MPI_MAX_PROCESSOR_NAME] = {0};
+  int host_len;
+  MPI_Get_processor_name(host, &host_len);
+
+  int *rank_node = NULL;
+  char *hosts = NULL;
+  int nr_nodes = 0;
+
+  if (rank == 0) {
+    rank_node = malloc(world_size * sizeof(int));
+    hosts = malloc(world_size * MPI_MAX_PROCESSOR_NAME);
+  }
+  MPI_Gather(&node_leader, 1, MPI_INT, rank_node, 1, MPI_INT, 0,
+             MPI_COMM_WORLD);
+  MPI_Gather(host, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, hosts,
+             MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+  if (rank == 0) {
+    for (int i = 0; i < world_size; i++) {
+      rank_node[i] = rank_node[i] == i ? nr_nodes++ : rank_node[rank_node[i]];
+    }
+  }
+
   // get the number of cpu from open mp
   // const int nr_cpu = omp_get_num_procs();
   vec_size = vec_size / world_size;
@@ -411,6 +1264,7 @@ int main(int argc, char **argv) {
     printf("\n");
     printf(HLINE);
     printf("Number of MPI processes:               %d\n", world_size);
+    printf("OpenMP threads per process:            %d\n", omp_threads);
     printf("Adjusted vector size:                  %lu elements\n", vec_size);
     printf("MB Vector size per process:            %f MB\n", MB_vec_size);
     printf("GB Vector size per process:            %f GB\n", GB_vec_size);
@@ -418,14 +1272,14 @@ int main(int argc, char **argv) {
            (GB_vec_size * 4 * world_size));
     printf("Repetitions:                           %d\n",
            benchmark_repetitions);
+    print_cpu_binding(bind_policy, rank_cpus, node_size * omp_threads);
     printf(HLINE);
     printf("\n");
   }
 
   struct streams_args *args =
       (struct streams_args *)malloc(world_size * sizeof(struct streams_args));
-
-  args[rank] = make_stream_args(vec_size, vec_size_proc, benchmark_repetitions);
+  MPI_Datatype stream_args_type = make_stream_args_type();
 
   float_type *a = (float_type *)stream_calloc(
       VECTOR_LEN * sizeof(float_type), vec_size_proc, sizeof(float_type));
@@ -439,90 +1293,260 @@ int main(int argc, char **argv) {
   float_type *d = (float_type *)stream_calloc(
       VECTOR_LEN * sizeof(float_type), vec_size_proc, sizeof(float_type));
 
-  unsigned int r = 1;
-  for (int i = 0; i < vec_size_proc; i++) {
-    r = generate_random_number(r);
-    a[i] = 1.0 + (float_type)(r % 300) / 200.0;
-    b[i] = 1.0 + (float_type)(r % 400) / 300.0;
-    c[i] = 1.0 + (float_type)(r % 500) / 300.0;
-    d[i] = 0.0;
+  // with --init serial the pages of all the ranks of a node are placed on
+  // the NUMA node of its first rank, as if a single process touched them
+  if (serial_init) {
+    int first_node = cpu_to_numa_node(sched_getcpu());
+    MPI_Bcast(&first_node, 1, MPI_INT, 0, node_comm);
+    set_preferred_numa_node(first_node);
   }
 
+  struct timespec init_start, init_end;
   MPI_Barrier(MPI_COMM_WORLD);
-  FMA_test(a, b, c, d, &args[rank]);
+  clock_gettime(CLOCK_MONOTONIC, &init_start);
+
+  // in the hybrid mode the threads first touch the vectors of the static
+  // schedule of the kernels
+#pragma omp parallel if (omp_threads > 1 && !serial_init)
+  {
+    unsigned int r = omp_get_thread_num() + 1;
+
+#pragma omp for schedule(static)
+    for (size_t v = 0; v < vec_size_proc / VECTOR_LEN; v++) {
+      for (size_t i = v * VECTOR_LEN; i < (v + 1) * VECTOR_LEN; i++) {
+        r = generate_random_number(r);
+        a[i] = 1.0 + (float_type)(r % 300) / 200.0;
+        b[i] = 1.0 + (float_type)(r % 400) / 300.0;
+        c[i] = 1.0 + (float_type)(r % 500) / 300.0;
+        d[i] = 0.0;
+      }
+    }
+  }
 
-  MPI_Barrier(MPI_COMM_WORLD);
-  copy_test(a, b, c, d, &args[rank]);
+  clock_gettime(CLOCK_MONOTONIC, &init_end);
 
-  MPI_Barrier(MPI_COMM_WORLD);
-  axpy_test(a, b, c, d, &args[rank]);
+  if (serial_init) {
+    set_preferred_numa_node(-1);
+  }
 
-  MPI_Barrier(MPI_COMM_WORLD);
-  add_mul_test(a, b, c, d, &args[rank]);
+  double init_time = get_time(init_start, init_end);
+  double max_init_time = 0.0;
+  MPI_Reduce(&init_time, &max_init_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  // read back after the first touch, THP and hugetlbfs may have fallen back
+  char pages[32];
+  describe_pages(a, pages, sizeof(pages));
 
   if (rank == 0) {
-    for (int i = 1; i < world_size; i++) {
-      MPI_Recv(&args[i], sizeof(struct streams_args), MPI_CHAR, i, 0,
-               MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    }
-  } else {
-    MPI_Send(&args[rank], sizeof(struct streams_args), MPI_CHAR, 0, 0,
-             MPI_COMM_WORLD);
+    printf("Initialization (%s first touch):  %.3f ms (slowest rank)\n",
+           serial_init ? "first rank node" : "local", max_init_time);
+    printf("Pages (%s requested, rank 0):  %s\n\n", page_mode_name(page_mode),
+           pages);
   }
 
-  double FMA_total_bandwidth = 0.0;
-  double copy_total_bandwidth = 0.0;
-  double axpy_total_bandwidth = 0.0;
-  double add_mul_total_bandwidth = 0.0;
+  // axpy, copy, fma, add_mult for each store mode, filled on rank 0
+  struct results_data results[8];
+  int nr_results = 0;
 
-  double clock_FMA = 0.0;
-  double clock_copy = 0.0;
-  double clock_axpy = 0.0;
-  double clock_add_mul = 0.0;
+  for (int nt = 0; nt < 2; nt++) {
 
-  if (rank == 0) {
+    if (!(store_mode & (nt ? STORE_NT : STORE_REGULAR))) {
+      continue;
+    }
 
-    for (int i = 0; i < world_size; i++) {
-      FMA_total_bandwidth += (args[i].FMA.bandwidth / to_GB);
-      clock_FMA += args[i].FMA.clock;
+    args[rank] = make_stream_args(vec_size, vec_size_proc, benchmark_repetitions);
+    args[rank].warmup = warmup;
+    args[rank].nt_store = nt;
 
-      copy_total_bandwidth += (args[i].copy.bandwidth / to_GB);
-      clock_copy += args[i].copy.clock;
+    // per repetition clocks of this rank: axpy, copy, FMA, add mul
+    const int total_repetitions = warmup + benchmark_repetitions;
+    double *clocks = malloc(4 * total_repetitions * sizeof(double));
 
-      axpy_total_bandwidth += (args[i].axpy.bandwidth / to_GB);
-      clock_axpy += args[i].axpy.clock;
+    MPI_Barrier(MPI_COMM_WORLD);
+    axpy_test(a, b, c, d, &args[rank], clocks);
 
-      add_mul_total_bandwidth += (args[i].add_mul.bandwidth / to_GB);
-      clock_add_mul += args[i].add_mul.clock;
+    MPI_Barrier(MPI_COMM_WORLD);
+    copy_test(a, b, c, d, &args[rank], clocks + total_repetitions);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    FMA_test(a, b, c, d, &args[rank], clocks + 2 * total_repetitions);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    add_mul_test(a, b, c, d, &args[rank], clocks + 3 * total_repetitions);
+
+    // rank 0 collects the samples of every rank, one row per rank
+    struct stream_samples *samples[4] = {NULL};
+
+    for (int k = 0; k < 4; k++) {
+      if (rank == 0) {
+        samples[k] = stream_samples_create(world_size, total_repetitions,
+                                           warmup);
+      }
+      MPI_Gather(clocks + k * total_repetitions, total_repetitions, MPI_DOUBLE,
+                 rank == 0 ? samples[k]->clock : NULL, total_repetitions,
+                 MPI_DOUBLE, 0, MPI_COMM_WORLD);
     }
+    free(clocks);
 
-    clock_FMA /= world_size;
-    clock_copy /= world_size;
-    clock_axpy /= world_size;
-    clock_add_mul /= world_size;
+    MPI_Gather(rank == 0 ? MPI_IN_PLACE : &args[rank], 1, stream_args_type,
+               args, 1, stream_args_type, 0, MPI_COMM_WORLD);
 
-    printf("Results:\n");
-    printf(HLINE);
-    printf("Test            Total bandwidth        clock  \n");
-    printf(HLINE);
-    printf("FMA:            %8.3f GB/s,          %5.3f ms\n",
-           FMA_total_bandwidth, clock_FMA);
-    printf("copy:           %8.3f GB/s,          %5.3f ms\n",
-           copy_total_bandwidth, clock_copy);
-    printf("axpy (TRIAD):   %8.3f GB/s,          %5.3f ms\n",
-           axpy_total_bandwidth, clock_axpy);
-    printf("add mul:        %8.3f GB/s,          %5.3f ms\n",
-           add_mul_total_bandwidth, clock_add_mul);
+    double FMA_total_bandwidth = 0.0;
+    double copy_total_bandwidth = 0.0;
+    double axpy_total_bandwidth = 0.0;
+    double add_mul_total_bandwidth = 0.0;
 
-    printf("\n");
-    printf(HLINE);
+    double clock_FMA = 0.0;
+    double clock_copy = 0.0;
+    double clock_axpy = 0.0;
+    double clock_add_mul = 0.0;
+
+    if (rank == 0) {
+
+      for (int i = 0; i < world_size; i++) {
+        FMA_total_bandwidth += (args[i].FMA.bandwidth / to_GB);
+        clock_FMA += args[i].FMA.clock;
+
+        copy_total_bandwidth += (args[i].copy.bandwidth / to_GB);
+        clock_copy += args[i].copy.clock;
+
+        axpy_total_bandwidth += (args[i].axpy.bandwidth / to_GB);
+        clock_axpy += args[i].axpy.clock;
+
+        add_mul_total_bandwidth += (args[i].add_mul.bandwidth / to_GB);
+        clock_add_mul += args[i].add_mul.clock;
+      }
+
+      clock_FMA /= world_size;
+      clock_copy /= world_size;
+      clock_axpy /= world_size;
+      clock_add_mul /= world_size;
+
+      const char *labels[4] = {"axpy (TRIAD):", "copy:", "FMA:", "add mul:"};
+      const char *ids[4] = {"axpy", "copy", "fma", "add_mult"};
+      const int nr_streams[4] = {3, 2, 4, 4};
+
+      // the sum of the rates of the ranks assumes that they all streamed in
+      // the same window, the aggregate divides all the bytes by the time of
+      // the slowest rank of each repetition
+      const double sum_bandwidth[4] = {axpy_total_bandwidth,
+                                       copy_total_bandwidth,
+                                       FMA_total_bandwidth,
+                                       add_mul_total_bandwidth};
+      const double clock[4] = {clock_axpy, clock_copy, clock_FMA,
+                               clock_add_mul};
+      double aggregate_bandwidth[4];
+
+      printf("Results%s:\n", nt ? " (non-temporal stores)" : "");
+      printf(HLINE);
+      printf("Test              Aggregate    Sum of ranks        clock\n");
+      printf(HLINE);
+      for (int k = 0; k < 4; k++) {
+        aggregate_bandwidth[k] =
+            compute_bandwidth(world_size, nr_streams[k], vec_size_proc,
+                              slowest_rank_time(samples[k], rank_node, -1),
+                              sizeof(float_type)) /
+            to_GB;
+        printf("%-14s  %8.3f GB/s   %8.3f GB/s  %8.3f ms\n", labels[k],
+               aggregate_bandwidth[k], sum_bandwidth[k], clock[k]);
+      }
+
+      printf("\n");
+      printf(HLINE);
+
+      for (int k = 0; k < 4; k++) {
+        print_node_breakdown(ids[k], samples[k], rank_node, hosts, nr_nodes,
+                             (double)nr_streams[k] * vec_size_proc *
+                                 sizeof(float_type));
+      }
+
+      if (omp_threads > 1) {
+        printf("Per rank, %d OpenMP threads each [GB/s]:\n", omp_threads);
+        printf(HLINE);
+        printf("Rank        axpy        copy         FMA     add mul\n");
+        printf(HLINE);
+        for (int i = 0; i < world_size; i++) {
+          printf("%4d  %10.3f  %10.3f  %10.3f  %10.3f\n", i,
+                 args[i].axpy.bandwidth / to_GB, args[i].copy.bandwidth / to_GB,
+                 args[i].FMA.bandwidth / to_GB,
+                 args[i].add_mul.bandwidth / to_GB);
+        }
+        printf(HLINE);
+        printf("\n");
+      }
+
+      print_sample_stats_header(warmup);
+      for (int k = 0; k < 4; k++) {
+        struct sample_stats stats;
+        stream_samples_stats(samples[k], &stats);
+
+        const double bytes = (double)nr_streams[k] * vec_size_proc *
+                             world_size * sizeof(float_type);
+
+        print_sample_stats(labels[k], &stats, bytes);
+        make_results_data(&results[nr_results++], ids[k], nt, &stats, bytes);
+      }
+      printf(HLINE);
+      printf("\n");
+
+      if (perf_enabled()) {
+        struct perf_values perf[4] = {{{0}}};
+        for (int i = 0; i < world_size; i++) {
+          perf_values_add(&perf[0], &args[i].axpy.perf);
+          perf_values_add(&perf[1], &args[i].copy.perf);
+          perf_values_add(&perf[2], &args[i].FMA.perf);
+          perf_values_add(&perf[3], &args[i].add_mul.perf);
+        }
+
+        print_perf_header();
+        for (int k = 0; k < 4; k++) {
+          const double bytes = (double)nr_streams[k] * vec_size_proc *
+                               world_size * sizeof(float_type) *
+                               benchmark_repetitions;
+          print_perf_row(labels[k], &perf[k], bytes, aggregate_bandwidth[k]);
+        }
+        printf(HLINE);
+        printf("\n");
+      }
+    }
+
+    for (int k = 0; k < 4; k++) {
+      stream_samples_free(samples[k]);
+    }
+  }
+
+  if (rank == 0) {
+    const struct results_info info = {
+        .benchmark = "mpi",
+        .nr_threads = omp_threads,
+        .nr_ranks = world_size,
+        .binding = bind_policy != NULL ? bind_policy : "none",
+        .pages = pages,
+        .vec_size = vec_size,
+        .element_size = sizeof(float_type),
+        .repetitions = benchmark_repetitions,
+        .warmup = warmup};
+
+    if (results_output_write(results_out, output_format, &info, results,
+                             nr_results)) {
+      printf("Error: cannot write the results\n");
+    }
   }
 
-  free(a);
-  free(b);
-  free(c);
-  free(d);
+  perf_imc_close();
+
+  stream_free(a);
+  stream_free(b);
+  stream_free(c);
+  stream_free(d);
+  free(rank_cpus);
+  free(rank_node);
+  free(hosts);
+  free(args);
 
+  MPI_Type_free(&stream_args_type);
+  MPI_Comm_free(&node_comm);
   MPI_Finalize();
   return 0;
 }
@@ -35,6 +35,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 #include <time.h>
 
+#include "my_stream_nt.h"
+#include "my_stream_perf.h"
 #include "my_stream_utils.h"
 
 #define DEFAULT_TEST_SIZE 50000000
@@ -52,8 +54,29 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 typedef double float_type;
 
+typedef float_type vector_type
+    __attribute__((vector_size(VECTOR_LEN * sizeof(float_type)), //
+                   aligned(sizeof(float_type))));                //
+
+/* NUMA node of the vectors, -1 for the default allocation */
+int mem_node = -1;
+
+/* pages backing the vectors, one of PAGES_* */
+int page_mode = PAGES_DEFAULT;
+
 void *stream_calloc(size_t __alignment, size_t vector_len, size_t type_size) {
 
+  if (mem_node >= 0 || page_mode != PAGES_DEFAULT) {
+    void *ptr = stream_mmap_alloc(vector_len * type_size, mem_node,
+                                  page_mode);
+    if (ptr == NULL) {
+      printf("Error: cannot allocate the vectors (NUMA node %d, %s pages)\n",
+             mem_node, page_mode_name(page_mode));
+      exit(1);
+    }
+    return ptr;
+  }
+
 #if OPENMP_VERSION < 201811
 
 #pragma message "Using alligned_alloc from C11"
@@ -69,6 +92,10 @@ void *stream_calloc(size_t __alignment, size_t vector_len, size_t type_size) {
 
 void stream_free(void *ptr) {
 
+  if (stream_mmap_free(ptr)) {
+    return;
+  }
+
 #if OPENMP_VERSION < 201811
   free(ptr);
 #else
@@ -76,11 +103,69 @@ void stream_free(void *ptr) {
 #endif
 }
 
+/**
+ * @brief With --perf, arms the counters of every thread of the team (and the
+ * memory controller ones) before the clock of a repetition starts.
+ */
+void perf_team_start(void) {
+  if (!perf_enabled()) {
+    return;
+  }
+
+  perf_imc_start();
+#pragma omp parallel
+  { perf_thread_start(); }
+}
+
+/**
+ * @brief Reads the counters of the team after the clock of a repetition
+ * stopped.
+ *
+ * @param acc
+ * @param rep the warm-up repetitions are not accumulated
+ * @param warmup
+ */
+void perf_team_stop(struct perf_values *acc, const int rep, const int warmup) {
+  if (!perf_enabled()) {
+    return;
+  }
+
+  struct perf_values team = {{0}};
+  perf_imc_stop(&team);
+
+#pragma omp parallel
+  {
+    struct perf_values v = {{0}};
+    perf_thread_stop(&v);
+#pragma omp critical
+    perf_values_add(&team, &v);
+  }
+
+  if (rep >= warmup) {
+    perf_values_add(acc, &team);
+  }
+}
+
 int main(const int argc, const char *argv[]) {
 
   size_t vec_size = DEFAULT_TEST_SIZE;
   int benchmark_repetitions = BENCHMARK_REPETITIONS;
-  const int nr_cpu = omp_get_num_procs();
+  int nr_cpu = omp_get_num_procs();
+
+  // opened first: with csv or json on stdout the report moves to stderr
+  const int output_format =
+      parse_output_format(find_command_line_arg_value(argc, argv, "--output"));
+  if (output_format < 0) {
+    printf("Error: --output must be text, csv or json\n");
+    return 1;
+  }
+
+  FILE *results_out = results_output_open(
+      output_format, find_command_line_arg_value(argc, argv, "--output-file"));
+  if (output_format != OUTPUT_TEXT && results_out == NULL) {
+    printf("Error: cannot open the --output-file\n");
+    return 1;
+  }
 
   printf("Start My Stream  [OpenMP]\n\n");
 
@@ -125,6 +210,89 @@ int main(const int argc, const char *argv[]) {
     }
   }
 
+  const char *mem_node_arg = find_command_line_arg_value(argc, argv, "--membind");
+
+  if (mem_node_arg != NULL) {
+    if (is_number(mem_node_arg)) {
+      mem_node = atoi(mem_node_arg);
+      printf("User defined NUMA node of the vectors: %d\n", mem_node);
+    } else {
+      printf("Error: argument of --membind is not numeric\n");
+      return 1;
+    }
+  }
+
+  int warmup = DEFAULT_WARMUP;
+  const char *warmup_arg = find_command_line_arg_value(argc, argv, "--warmup");
+  if (warmup_arg != NULL) {
+    if (!is_number(warmup_arg)) {
+      printf("Error: argument of --warmup is not numeric\n");
+      return 1;
+    }
+    warmup = atoi(warmup_arg);
+  }
+
+  page_mode =
+      parse_page_mode(find_command_line_arg_value(argc, argv, "--pages"));
+  if (page_mode < 0) {
+    printf("Error: --pages must be 4k, thp, 2m or 1g\n");
+    return 1;
+  }
+
+  const int store_mode =
+      parse_store_mode(find_command_line_arg_value(argc, argv, "--store"));
+  if (store_mode == 0) {
+    printf("Error: --store must be regular, nt or both\n");
+    return 1;
+  }
+
+  const char *threads_arg = find_command_line_arg_value(argc, argv, "--threads");
+  if (threads_arg != NULL) {
+    int *counts;
+    const int nr_counts = parse_thread_list(threads_arg, &counts);
+    if (nr_counts != 1) {
+      printf("Error: --threads takes a single thread count, the scaling sweep "
+             "is in my_stream_mt_gm\n");
+      free(counts);
+      return 1;
+    }
+    nr_cpu = counts[0];
+    free(counts);
+
+    // oversubscribed threads would time slice
+    if (nr_cpu > nr_allowed_cpus()) {
+      printf("Error: --threads %d exceeds the %d CPUs the process may run "
+             "on\n",
+             nr_cpu, nr_allowed_cpus());
+      return 1;
+    }
+
+    omp_set_num_threads(nr_cpu);
+  }
+
+  // by default the placement is left to OMP_PLACES / OMP_PROC_BIND
+  const char *bind_policy = find_command_line_arg_value(argc, argv, "--bind");
+  const int nr_threads = omp_get_max_threads();
+
+  int *thread_cpus = make_cpu_binding(bind_policy, nr_threads);
+  if (thread_cpus == NULL) {
+    printf("Error: invalid --bind policy %s, a CPU not allowed or fewer "
+           "CPUs than the %d threads\n",
+           bind_policy, nr_threads);
+    return 1;
+  }
+
+  int bind_error = 0;
+#pragma omp parallel reduction(| : bind_error)
+  bind_error |= bind_thread_to_cpu(pthread_self(),
+                                   thread_cpus[omp_get_thread_num()]) != 0;
+
+  if (bind_error) {
+    printf("Error: cannot bind the threads with --bind %s\n", bind_policy);
+    free(thread_cpus);
+    return 1;
+  }
+
   vec_size = vec_size / nr_cpu;
   vec_size = ((vec_size - vec_size % VECTOR_LEN) + VECTOR_LEN) * nr_cpu;
 
@@ -139,49 +307,96 @@ int main(const int argc, const char *argv[]) {
   printf("GB Vector size:            %f [GB]\n", GB_vec_size);
   printf("GB Total allocated memory: %f [GB]\n", GB_vec_size * 4);
   printf("Repetitions:               %d\n", benchmark_repetitions);
+  print_cpu_binding(bind_policy, thread_cpus, nr_threads);
   printf("-----------------------------------------------------------\n\n");
 
-  double *clock_axpy = malloc(sizeof(float_type) * benchmark_repetitions);
-  double *clock_fma = malloc(sizeof(float_type) * benchmark_repetitions);
-  double *clock_copy = malloc(sizeof(float_type) * benchmark_repetitions);
-  double *clock_addmul = malloc(sizeof(float_type) * benchmark_repetitions);
-
-  { /// Begin benckmark
-    float_type *a =
-        (float_type *)stream_calloc(1024, vec_size, sizeof(float_type));
-    float_type *b =
-        (float_type *)stream_calloc(1024, vec_size, sizeof(float_type));
-    float_type *c =
-        (float_type *)stream_calloc(1024, vec_size, sizeof(float_type));
-    float_type *d =
-        (float_type *)stream_calloc(1024, vec_size, sizeof(float_type));
-
-    double consume_out = 0.0;
-    const double alpha = 2.56;
+  // a sample per repetition: the time of the whole team
+  const int total_repetitions = warmup + benchmark_repetitions;
+
+  struct stream_samples *samples_axpy =
+      stream_samples_create(1, total_repetitions, warmup);
+  struct stream_samples *samples_fma =
+      stream_samples_create(1, total_repetitions, warmup);
+  struct stream_samples *samples_copy =
+      stream_samples_create(1, total_repetitions, warmup);
+  struct stream_samples *samples_addmul =
+      stream_samples_create(1, total_repetitions, warmup);
+
+  float_type *a =
+      (float_type *)stream_calloc(1024, vec_size, sizeof(float_type));
+  float_type *b =
+      (float_type *)stream_calloc(1024, vec_size, sizeof(float_type));
+  float_type *c =
+      (float_type *)stream_calloc(1024, vec_size, sizeof(float_type));
+  float_type *d =
+      (float_type *)stream_calloc(1024, vec_size, sizeof(float_type));
+
+  vector_type *a_vec = (vector_type *)a;
+  vector_type *b_vec = (vector_type *)b;
+  vector_type *c_vec = (vector_type *)c;
+
+  const size_t size_vec = vec_size / VECTOR_LEN;
 
 #pragma omp parallel for
-    for (int i = 0; i < vec_size; i++) {
-      a[i] = 1.0 + (float_type)(i % 300) / 200.0;
-      b[i] = 1.0 + (float_type)(i % 200) / 150.0;
-      c[i] = 1.0 + (float_type)(i % 150) / 100.0;
-      d[i] = 0.0;
+  for (int i = 0; i < vec_size; i++) {
+    a[i] = 1.0 + (float_type)(i % 300) / 200.0;
+    b[i] = 1.0 + (float_type)(i % 200) / 150.0;
+    c[i] = 1.0 + (float_type)(i % 150) / 100.0;
+    d[i] = 0.0;
+  }
+
+  // read back after the first touch, THP and hugetlbfs may have fallen back
+  char pages[32];
+  describe_pages(a, pages, sizeof(pages));
+  printf("Pages (%s requested):  %s\n", page_mode_name(page_mode), pages);
+
+  if (flag_exists(argc, argv, "--perf") && perf_init(1)) {
+    printf("IMC counters: %d\n", perf_imc_open());
+  }
+
+  // axpy, copy, fma, add_mult for each store mode
+  struct results_data results[8];
+  int nr_results = 0;
+
+  for (int nt = 0; nt < 2; nt++) { /// Begin benckmark
+
+    if (!(store_mode & (nt ? STORE_NT : STORE_REGULAR))) {
+      continue;
     }
 
+    double consume_out = 0.0;
+    const double alpha = 2.56;
+
     struct timespec start, end;
+    struct perf_values perf_axpy = {{0}}, perf_fma = {{0}}, perf_copy = {{0}},
+                       perf_addmul = {{0}};
 
     //// FMA
-    for (int r = 0; r < benchmark_repetitions; r++) {
+    for (int r = 0; r < total_repetitions; r++) {
 
+      perf_team_start();
       clock_gettime(CLOCK_MONOTONIC, &start);
 
+      if (nt) {
+#pragma omp parallel
+        {
+#pragma omp for nowait
+          for (size_t i = 0; i < size_vec; i++) {
+            stream_nt_store(&d[i * VECTOR_LEN], a_vec[i] * b_vec[i] + c_vec[i]);
+          }
+          stream_nt_fence();
+        }
+      } else {
 #pragma omp parallel for
-      for (size_t i = 0; i < vec_size; i++) {
-        d[i] = a[i] * b[i] + c[i];
+        for (size_t i = 0; i < vec_size; i++) {
+          d[i] = a[i] * b[i] + c[i];
+        }
       }
 
       clock_gettime(CLOCK_MONOTONIC, &end);
+      perf_team_stop(&perf_fma, r, warmup);
 
-      clock_fma[r] = get_time(start, end);
+      stream_samples_set(samples_fma, 0, r, get_time(start, end));
 
       consume_out += a[rand() % vec_size] + b[rand() % vec_size] +
                      c[rand() % vec_size] + d[rand() % vec_size];
@@ -189,96 +404,199 @@ int main(const int argc, const char *argv[]) {
     }
 
     //// AXPY
-    for (int r = 0; r < benchmark_repetitions; r++) {
+    for (int r = 0; r < total_repetitions; r++) {
 
+      perf_team_start();
       clock_gettime(CLOCK_MONOTONIC, &start);
 
+      if (nt) {
+#pragma omp parallel
+        {
+#pragma omp for nowait
+          for (size_t i = 0; i < size_vec; i++) {
+            stream_nt_store(&d[i * VECTOR_LEN], alpha * a_vec[i] + b_vec[i]);
+          }
+          stream_nt_fence();
+        }
+      } else {
 #pragma omp parallel for
-      for (size_t i = 0; i < vec_size; i++) {
-        d[i] = alpha * a[i] + b[i];
+        for (size_t i = 0; i < vec_size; i++) {
+          d[i] = alpha * a[i] + b[i];
+        }
       }
 
       clock_gettime(CLOCK_MONOTONIC, &end);
+      perf_team_stop(&perf_axpy, r, warmup);
 
-      clock_axpy[r] = get_time(start, end);
+      stream_samples_set(samples_axpy, 0, r, get_time(start, end));
 
       consume_out += d[rand() % vec_size];
       // printf("n %f ", consume_out);
     }
 
     //// COPY
-    for (int r = 0; r < benchmark_repetitions; r++) {
+    for (int r = 0; r < total_repetitions; r++) {
 
+      perf_team_start();
       clock_gettime(CLOCK_MONOTONIC, &start);
 
+      if (nt) {
+#pragma omp parallel
+        {
+#pragma omp for nowait
+          for (size_t i = 0; i < size_vec; i++) {
+            stream_nt_store(&d[i * VECTOR_LEN], a_vec[i]);
+          }
+          stream_nt_fence();
+        }
+      } else {
 #pragma omp parallel for
-      for (size_t i = 0; i < vec_size; i++) {
-        d[i] = a[i];
+        for (size_t i = 0; i < vec_size; i++) {
+          d[i] = a[i];
+        }
       }
 
       clock_gettime(CLOCK_MONOTONIC, &end);
+      perf_team_stop(&perf_copy, r, warmup);
 
-      clock_copy[r] = get_time(start, end);
+      stream_samples_set(samples_copy, 0, r, get_time(start, end));
 
       consume_out += d[rand() % vec_size];
       // printf("n %f ", consume_out);
     }
 
     //// ADDMUL
-    for (int r = 0; r < benchmark_repetitions; r++) {
+    for (int r = 0; r < total_repetitions; r++) {
 
+      perf_team_start();
       clock_gettime(CLOCK_MONOTONIC, &start);
 
+      if (nt) {
+#pragma omp parallel
+        {
+#pragma omp for nowait
+          for (size_t i = 0; i < size_vec; i++) {
+            stream_nt_store(&d[i * VECTOR_LEN], a_vec[i] + b_vec[i]);
+            stream_nt_store(&c[i * VECTOR_LEN], a_vec[i] * b_vec[i]);
+          }
+          stream_nt_fence();
+        }
+      } else {
 #pragma omp parallel for
-      for (size_t i = 0; i < vec_size; i++) {
-        d[i] = a[i] + b[i];
-        c[i] = a[i] * b[i];
+        for (size_t i = 0; i < vec_size; i++) {
+          d[i] = a[i] + b[i];
+          c[i] = a[i] * b[i];
+        }
       }
 
       clock_gettime(CLOCK_MONOTONIC, &end);
+      perf_team_stop(&perf_addmul, r, warmup);
 
-      clock_addmul[r] = get_time(start, end);
+      stream_samples_set(samples_addmul, 0, r, get_time(start, end));
 
       consume_out += c[rand() % vec_size] + d[rand() % vec_size];
       // printf("n %f ", consume_out);
     }
 
-    //    omp_free(a, omp_get_default_allocator());
-    //    omp_free(b, omp_get_default_allocator());
-    //    omp_free(c, omp_get_default_allocator());
-    //    omp_free(d, omp_get_default_allocator());
-    //
-    stream_free(a);
-    stream_free(b);
-    stream_free(c);
-    stream_free(d);
+    struct sample_stats stats_axpy, stats_fma, stats_copy, stats_addmul;
+    stream_samples_stats(samples_axpy, &stats_axpy);
+    stream_samples_stats(samples_fma, &stats_fma);
+    stream_samples_stats(samples_copy, &stats_copy);
+    stream_samples_stats(samples_addmul, &stats_addmul);
+
+    double avg_clock_axpy = stats_axpy.mean;
+    double avg_clock_fma = stats_fma.mean;
+    double avg_clock_copy = stats_copy.mean;
+    double avg_clock_addmul = stats_addmul.mean;
+
+    double bandwidth_axpy = compute_bandwidth(
+        1, 3, vec_size, avg_clock_axpy, sizeof(float_type));
+    double bandwidth_fma = compute_bandwidth(1, 4, vec_size, //
+                                             avg_clock_fma, sizeof(float_type));
+    double bandwidth_copy = compute_bandwidth(
+        1, 2, vec_size, avg_clock_copy, sizeof(float_type));
+    double bandwidth_addmul =
+        compute_bandwidth(1, 4,                                  //
+                          vec_size,                              //
+                          avg_clock_addmul, sizeof(float_type)); //
+
+    printf("\n-----------------------------------------------------------\n");
+    printf("RESULTS OpenMP%s\n", nt ? " (non-temporal stores)" : "");
+    print_performance_metrics(bandwidth_axpy, avg_clock_axpy, bandwidth_fma,
+                              avg_clock_fma, bandwidth_copy, avg_clock_copy,
+                              bandwidth_addmul, avg_clock_addmul, to_GB);
+
+    const double vec_bytes = (double)vec_size * sizeof(float_type);
+
+    print_sample_stats_header(warmup);
+    print_sample_stats("AXPY:", &stats_axpy, 3 * vec_bytes);
+    print_sample_stats("COPY:", &stats_copy, 2 * vec_bytes);
+    print_sample_stats("FMA:", &stats_fma, 4 * vec_bytes);
+    print_sample_stats("ADDMUL:", &stats_addmul, 4 * vec_bytes);
+    printf("-----------------------------------------------------------------"
+           "-------------------------\n\n");
+
+    if (perf_enabled()) {
+      const double measured_bytes = vec_bytes * benchmark_repetitions;
+
+      print_perf_header();
+      print_perf_row("AXPY:", &perf_axpy, 3 * measured_bytes,
+                     bandwidth_axpy / to_GB);
+      print_perf_row("COPY:", &perf_copy, 2 * measured_bytes,
+                     bandwidth_copy / to_GB);
+      print_perf_row("FMA:", &perf_fma, 4 * measured_bytes,
+                     bandwidth_fma / to_GB);
+      print_perf_row("ADDMUL:", &perf_addmul, 4 * measured_bytes,
+                     bandwidth_addmul / to_GB);
+      printf("---------------------------------------------------------------"
+             "---------------------------\n\n");
+    }
+
+    make_results_data(&results[nr_results++], "axpy", nt, &stats_axpy,
+                      3 * vec_bytes);
+    make_results_data(&results[nr_results++], "copy", nt, &stats_copy,
+                      2 * vec_bytes);
+    make_results_data(&results[nr_results++], "fma", nt, &stats_fma,
+                      4 * vec_bytes);
+    make_results_data(&results[nr_results++], "add_mult", nt, &stats_addmul,
+                      4 * vec_bytes);
   }
 
-  double avg_clock_axpy = average(clock_axpy, benchmark_repetitions);
-  double avg_clock_fma = average(clock_fma, benchmark_repetitions);
-  double avg_clock_copy = average(clock_copy, benchmark_repetitions);
-  double avg_clock_addmul = average(clock_addmul, benchmark_repetitions);
-
-  double bandwidth_axpy = compute_bandwidth(1, 3, vec_size, //
-                                            avg_clock_axpy, sizeof(float_type));
-  double bandwidth_fma = compute_bandwidth(1, 3, vec_size, //
-                                           avg_clock_fma, sizeof(float_type));
-  double bandwidth_copy = compute_bandwidth(1, 2, vec_size, //
-                                            avg_clock_copy, sizeof(float_type));
-  double bandwidth_addmul =
-      compute_bandwidth(1, 4,                                  //
-                        vec_size,                              //
-                        avg_clock_addmul, sizeof(float_type)); //
+  const struct results_info info = {
+      .benchmark = "omp",
+      .nr_threads = nr_threads,
+      .nr_ranks = 1,
+      .binding = bind_policy != NULL ? bind_policy : "none",
+      .pages = pages,
+      .vec_size = vec_size,
+      .element_size = sizeof(float_type),
+      .repetitions = benchmark_repetitions,
+      .warmup = warmup};
+
+  if (results_output_write(results_out, output_format, &info, results,
+                           nr_results)) {
+    printf("Error: cannot write the results\n");
+  }
 
-  printf("\n-----------------------------------------------------------\n");
-  printf("RESULTS OpenMP\n");
-  print_performance_metrics(bandwidth_axpy, avg_clock_axpy, bandwidth_fma,
-                            avg_clock_fma, bandwidth_copy, avg_clock_copy,
-                            bandwidth_addmul, avg_clock_addmul, to_GB);
-  free(clock_axpy);
-  free(clock_fma);
-  free(clock_copy);
-  free(clock_addmul);
+  //    omp_free(a, omp_get_default_allocator());
+  //    omp_free(b, omp_get_default_allocator());
+  //    omp_free(c, omp_get_default_allocator());
+  //    omp_free(d, omp_get_default_allocator());
+  //
+  stream_free(a);
+  stream_free(b);
+  stream_free(c);
+  stream_free(d);
+
+  if (perf_enabled()) {
+    perf_imc_close();
+  }
+
+  stream_samples_free(samples_axpy);
+  stream_samples_free(samples_fma);
+  stream_samples_free(samples_copy);
+  stream_samples_free(samples_addmul);
+  free(thread_cpus);
 
   return 0;
 }
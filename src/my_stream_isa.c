@@ -0,0 +1,359 @@
+/**
+my_stream
+Copyright (C) 2023
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file my_stream_isa.c
+ * @author Simone Riva (you@domain.com)
+ * @brief Kernels compiled for several instruction sets and in several shapes
+ * (vector width, unroll) in the same binary and selected at run time.
+ * @version 0.1
+ * @date 2023-12-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
+#include "my_stream_isa.h"
+
+/**
+ * Every flavour is compiled with a target attribute on top of the flags of
+ * the Makefile, so the file builds with -march=native as well as with a
+ * baseline -march (make PORTABLE=1). The width of the loads and stores is
+ * fixed by the vector type of the flavour, and the copy loops are kept as
+ * loops instead of being turned into calls to memcpy.
+ */
+#if defined(__clang__)
+// clang ignores the optimize attribute, the scalar flavour may be vectorized
+#define ISA_LOOP_ATTRIBUTES
+#define ISA_SCALAR_ATTRIBUTES
+#else
+#define ISA_LOOP_ATTRIBUTES                                                    \
+  __attribute__((optimize("no-tree-loop-distribute-patterns")))
+#define ISA_SCALAR_ATTRIBUTES                                                  \
+  __attribute__((                                                              \
+      optimize("no-tree-vectorize,no-tree-loop-distribute-patterns")))
+#endif
+
+#define MAKE_ISA_KERNELS(SUFFIX, ATTRIBUTES, BYTES)                            \
+  typedef double SUFFIX##_vector                                               \
+      __attribute__((vector_size(BYTES), aligned(BYTES)));                     \
+                                                                               \
+  static ATTRIBUTES void SUFFIX##_copy(double *d, const double *a,             \
+                                       const size_t n) {                       \
+    SUFFIX##_vector *d_vec = (SUFFIX##_vector *)d;                             \
+    const SUFFIX##_vector *a_vec = (const SUFFIX##_vector *)a;                 \
+    for (size_t i = 0; i < n * sizeof(double) / BYTES; i++) {                 \
+      d_vec[i] = a_vec[i];                                                     \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static ATTRIBUTES void SUFFIX##_axpy(double *d, const double *a,             \
+                                       const double *b, const double alpha,    \
+                                       const size_t n) {                       \
+    SUFFIX##_vector *d_vec = (SUFFIX##_vector *)d;                             \
+    const SUFFIX##_vector *a_vec = (const SUFFIX##_vector *)a;                 \
+    const SUFFIX##_vector *b_vec = (const SUFFIX##_vector *)b;                 \
+    for (size_t i = 0; i < n * sizeof(double) / BYTES; i++) {                 \
+      d_vec[i] = alpha * a_vec[i] + b_vec[i];                                  \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static ATTRIBUTES void SUFFIX##_fma(double *d, const double *a,              \
+                                      const double *b, const double *c,        \
+                                      const size_t n) {                        \
+    SUFFIX##_vector *d_vec = (SUFFIX##_vector *)d;                             \
+    const SUFFIX##_vector *a_vec = (const SUFFIX##_vector *)a;                 \
+    const SUFFIX##_vector *b_vec = (const SUFFIX##_vector *)b;                 \
+    const SUFFIX##_vector *c_vec = (const SUFFIX##_vector *)c;                 \
+    for (size_t i = 0; i < n * sizeof(double) / BYTES; i++) {                 \
+      d_vec[i] = a_vec[i] * b_vec[i] + c_vec[i];                               \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static ATTRIBUTES void SUFFIX##_add_mult(double *d, double *c,               \
+                                           const double *a, const double *b,   \
+                                           const size_t n) {                   \
+    SUFFIX##_vector *d_vec = (SUFFIX##_vector *)d;                             \
+    SUFFIX##_vector *c_vec = (SUFFIX##_vector *)c;                             \
+    const SUFFIX##_vector *a_vec = (const SUFFIX##_vector *)a;                 \
+    const SUFFIX##_vector *b_vec = (const SUFFIX##_vector *)b;                 \
+    for (size_t i = 0; i < n * sizeof(double) / BYTES; i++) {                 \
+      d_vec[i] = a_vec[i] + b_vec[i];                                          \
+      c_vec[i] = a_vec[i] * b_vec[i];                                          \
+    }                                                                          \
+  }
+
+#define ISA_ENTRY(NAME, SUFFIX, BITS, SUPPORTED)                               \
+  {                                                                            \
+    NAME, BITS, SUPPORTED, SUFFIX##_copy, SUFFIX##_axpy, SUFFIX##_fma,         \
+        SUFFIX##_add_mult                                                      \
+  }
+
+static int isa_always(void) { return 1; }
+
+MAKE_ISA_KERNELS(scalar, ISA_SCALAR_ATTRIBUTES, 8)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// __builtin_cpu_supports also checks that the OS saves the wide registers
+static int isa_has_avx2(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static int isa_has_avx512(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f");
+}
+
+MAKE_ISA_KERNELS(sse2, ISA_LOOP_ATTRIBUTES __attribute__((target("sse2"))), 16)
+MAKE_ISA_KERNELS(avx2, ISA_LOOP_ATTRIBUTES __attribute__((target("avx2,fma"))),
+                 32)
+MAKE_ISA_KERNELS(avx512, ISA_LOOP_ATTRIBUTES __attribute__((target("avx512f"))),
+                 64)
+
+const struct isa_kernels isa_table[] = {
+    ISA_ENTRY("scalar", scalar, 64, isa_always),
+    ISA_ENTRY("sse2", sse2, 128, isa_always),
+    ISA_ENTRY("avx2", avx2, 256, isa_has_avx2),
+    ISA_ENTRY("avx512", avx512, 512, isa_has_avx512),
+};
+
+#elif defined(__aarch64__)
+
+MAKE_ISA_KERNELS(neon, ISA_LOOP_ATTRIBUTES, 16)
+
+#if defined(HWCAP_SVE) && !defined(__clang__)
+
+static int isa_has_sve(void) { return (getauxval(AT_HWCAP) & HWCAP_SVE) != 0; }
+
+// the vector length is only known at run time: plain loops vectorized for SVE
+#define SVE_ATTRIBUTES ISA_LOOP_ATTRIBUTES __attribute__((target("+sve")))
+
+static SVE_ATTRIBUTES void sve_copy(double *d, const double *a,
+                                   const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    d[i] = a[i];
+  }
+}
+
+static SVE_ATTRIBUTES void sve_axpy(double *d, const double *a,
+                                   const double *b, const double alpha,
+                                   const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    d[i] = alpha * a[i] + b[i];
+  }
+}
+
+static SVE_ATTRIBUTES void sve_fma(double *d, const double *a, const double *b,
+                                  const double *c, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    d[i] = a[i] * b[i] + c[i];
+  }
+}
+
+static SVE_ATTRIBUTES void sve_add_mult(double *d, double *c, const double *a,
+                                       const double *b, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    d[i] = a[i] + b[i];
+    c[i] = a[i] * b[i];
+  }
+}
+
+#endif
+
+const struct isa_kernels isa_table[] = {
+    ISA_ENTRY("scalar", scalar, 64, isa_always),
+    ISA_ENTRY("neon", neon, 128, isa_always),
+#if defined(HWCAP_SVE) && !defined(__clang__)
+    ISA_ENTRY("sve", sve, 0, isa_has_sve),
+#endif
+};
+
+#else
+
+const struct isa_kernels isa_table[] = {
+    ISA_ENTRY("scalar", scalar, 64, isa_always),
+};
+
+#endif
+
+const int nr_isa = sizeof(isa_table) / sizeof(isa_table[0]);
+
+const struct isa_kernels *isa_find(const char *name) {
+
+  if (strcmp(name, "auto") == 0) {
+    const struct isa_kernels *best = &isa_table[0];
+    for (int i = 0; i < nr_isa; i++) {
+      if (isa_table[i].supported()) {
+        best = &isa_table[i];
+      }
+    }
+    return best;
+  }
+
+  for (int i = 0; i < nr_isa; i++) {
+    if (strcmp(name, isa_table[i].name) == 0) {
+      return &isa_table[i];
+    }
+  }
+
+  return NULL;
+}
+
+void print_isa_list(void) {
+
+  printf("Instruction sets:          ");
+  for (int i = 0; i < nr_isa; i++) {
+    printf("%s%s%s", i > 0 ? ", " : "", isa_table[i].name,
+           isa_table[i].supported() ? "" : " (unsupported)");
+  }
+  printf("\n");
+}
+
+/**
+ * The shapes are compiled with the flags of the Makefile and without the
+ * vectorizer: the width comes only from the vector type, which the compiler
+ * splits into registers of the target when it is wider. The unrolled body is
+ * a loop of constant trip count, fully unrolled by the compiler.
+ */
+#define VARIANT_ATTRIBUTES ISA_SCALAR_ATTRIBUTES
+
+#define MAKE_VARIANT_KERNELS(W, U)                                             \
+  static VARIANT_ATTRIBUTES void variant_copy_##W##x##U(                       \
+      double *d, const double *a, const size_t n) {                            \
+    variant##W##_vector *d_vec = (variant##W##_vector *)d;                     \
+    const variant##W##_vector *a_vec = (const variant##W##_vector *)a;         \
+    const size_t nv = n / W;                                                   \
+    size_t i = 0;                                                              \
+    for (; i + U <= nv; i += U) {                                              \
+      for (int u = 0; u < U; u++) {                                            \
+        d_vec[i + u] = a_vec[i + u];                                           \
+      }                                                                        \
+    }                                                                          \
+    for (; i < nv; i++) {                                                      \
+      d_vec[i] = a_vec[i];                                                     \
+    }                                                                          \
+    for (size_t j = nv * W; j < n; j++) {                                      \
+      d[j] = a[j];                                                             \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static VARIANT_ATTRIBUTES void variant_axpy_##W##x##U(                       \
+      double *d, const double *a, const double *b, const double alpha,         \
+      const size_t n) {                                                        \
+    variant##W##_vector *d_vec = (variant##W##_vector *)d;                     \
+    const variant##W##_vector *a_vec = (const variant##W##_vector *)a;         \
+    const variant##W##_vector *b_vec = (const variant##W##_vector *)b;         \
+    const size_t nv = n / W;                                                   \
+    size_t i = 0;                                                              \
+    for (; i + U <= nv; i += U) {                                              \
+      for (int u = 0; u < U; u++) {                                            \
+        d_vec[i + u] = alpha * a_vec[i + u] + b_vec[i + u];                    \
+      }                                                                        \
+    }                                                                          \
+    for (; i < nv; i++) {                                                      \
+      d_vec[i] = alpha * a_vec[i] + b_vec[i];                                  \
+    }                                                                          \
+    for (size_t j = nv * W; j < n; j++) {                                      \
+      d[j] = alpha * a[j] + b[j];                                              \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static VARIANT_ATTRIBUTES double variant_sum_##W##x##U(const double *a,      \
+                                                         const size_t n) {     \
+    const variant##W##_vector *a_vec = (const variant##W##_vector *)a;         \
+    const size_t nv = n / W;                                                   \
+    variant##W##_vector acc[U];                                                \
+    for (int u = 0; u < U; u++) {                                              \
+      acc[u] = (variant##W##_vector){0};                                       \
+    }                                                                          \
+    size_t i = 0;                                                              \
+    for (; i + U <= nv; i += U) {                                              \
+      for (int u = 0; u < U; u++) {                                            \
+        acc[u] += a_vec[i + u];                                                \
+      }                                                                        \
+    }                                                                          \
+    for (; i < nv; i++) {                                                      \
+      acc[0] += a_vec[i];                                                      \
+    }                                                                          \
+    double sum = 0.0;                                                          \
+    for (int u = 0; u < U; u++) {                                              \
+      const double *lanes = (const double *)&acc[u];                           \
+      for (int w = 0; w < W; w++) {                                            \
+        sum += lanes[w];                                                       \
+      }                                                                        \
+    }                                                                          \
+    for (size_t j = nv * W; j < n; j++) {                                      \
+      sum += a[j];                                                             \
+    }                                                                          \
+    return sum;                                                                \
+  }
+
+#define MAKE_VARIANT_UNROLLS(W)                                                \
+  MAKE_VARIANT_KERNELS(W, 1)                                                   \
+  MAKE_VARIANT_KERNELS(W, 2)                                                   \
+  MAKE_VARIANT_KERNELS(W, 4)                                                   \
+  MAKE_VARIANT_KERNELS(W, 8)
+
+#define VARIANT_ENTRY(W, U)                                                    \
+  { W, U, variant_copy_##W##x##U, variant_axpy_##W##x##U, variant_sum_##W##x##U }
+
+#define VARIANT_ENTRIES(W)                                                     \
+  VARIANT_ENTRY(W, 1), VARIANT_ENTRY(W, 2), VARIANT_ENTRY(W, 4),               \
+      VARIANT_ENTRY(W, 8)
+
+// the vectors are aligned on their size, up to a cache line
+#define MAKE_VARIANT_WIDTH(W)                                                  \
+  typedef double variant##W##_vector __attribute__((                           \
+      vector_size(W * sizeof(double)),                                         \
+      aligned(W * sizeof(double) < 64 ? W * sizeof(double) : 64)));            \
+  MAKE_VARIANT_UNROLLS(W)
+
+// GCC keeps one element vectors in memory, width 1 is a plain double
+typedef double variant1_vector;
+MAKE_VARIANT_UNROLLS(1)
+
+MAKE_VARIANT_WIDTH(2)
+MAKE_VARIANT_WIDTH(4)
+MAKE_VARIANT_WIDTH(8)
+MAKE_VARIANT_WIDTH(16)
+
+const struct variant_kernels
+    variant_table[VARIANT_NR_WIDTHS * VARIANT_NR_UNROLLS] = {
+        VARIANT_ENTRIES(1), VARIANT_ENTRIES(2), VARIANT_ENTRIES(4),
+        VARIANT_ENTRIES(8), VARIANT_ENTRIES(16),
+};
+
+const struct variant_kernels *variant_find(const int width, const int unroll) {
+
+  for (int i = 0; i < VARIANT_NR_WIDTHS * VARIANT_NR_UNROLLS; i++) {
+    if (variant_table[i].width == width && variant_table[i].unroll == unroll) {
+      return &variant_table[i];
+    }
+  }
+
+  return NULL;
+}
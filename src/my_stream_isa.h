@@ -0,0 +1,128 @@
+/**
+my_stream
+Copyright (C) 2023
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file my_stream_isa.h
+ * @author Simone Riva (you@domain.com)
+ * @brief Kernels compiled for several instruction sets and in several shapes
+ * (vector width, unroll) in the same binary and selected at run time.
+ * @version 0.1
+ * @date 2023-12-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef __MY_STREAM_ISA__
+#define __MY_STREAM_ISA__
+
+#include <stddef.h>
+
+/**
+ * @brief One flavour of the kernels. The arrays are aligned on 64 bytes and n,
+ * the number of doubles, is a multiple of 8.
+ */
+struct isa_kernels {
+  const char *name;
+  // width of the loads and stores, 0 when it is only known at run time (SVE)
+  int vector_bits;
+  int (*supported)(void);
+
+  void (*copy)(double *d, const double *a, const size_t n);
+  void (*axpy)(double *d, const double *a, const double *b, const double alpha,
+               const size_t n);
+  void (*fma)(double *d, const double *a, const double *b, const double *c,
+              const size_t n);
+  void (*add_mult)(double *d, double *c, const double *a, const double *b,
+                   const size_t n);
+};
+
+/**
+ * @brief The flavours built for the target architecture, from the narrowest
+ * to the widest.
+ */
+extern const struct isa_kernels isa_table[];
+extern const int nr_isa;
+
+/**
+ * @brief
+ *
+ * @param name name of a flavour, or auto for the widest one the CPU supports
+ * @return const struct isa_kernels* NULL if the name is unknown
+ */
+const struct isa_kernels *isa_find(const char *name);
+
+/**
+ * @brief Prints the flavours built in the binary and which of them the CPU
+ * supports.
+ */
+void print_isa_list(void);
+
+#define VARIANT_COPY 0
+#define VARIANT_AXPY 1
+#define VARIANT_SUM 2
+#define VARIANT_NR_KERNELS 3
+
+#define VARIANT_NR_WIDTHS 5
+#define VARIANT_NR_UNROLLS 4
+
+/**
+ * @brief One shape of the kernels: vectors of width doubles, unroll vectors
+ * per iteration, and unroll independent accumulators in the reduction. n, the
+ * number of doubles, can be any value.
+ */
+struct variant_kernels {
+  int width;
+  int unroll;
+
+  void (*copy)(double *d, const double *a, const size_t n);
+  void (*axpy)(double *d, const double *a, const double *b, const double alpha,
+               const size_t n);
+  double (*sum)(const double *a, const size_t n);
+};
+
+/**
+ * @brief Widths 1, 2, 4, 8, 16 times unroll factors 1, 2, 4, 8, width major.
+ */
+extern const struct variant_kernels
+    variant_table[VARIANT_NR_WIDTHS * VARIANT_NR_UNROLLS];
+
+/**
+ * @brief
+ *
+ * @param width
+ * @param unroll
+ * @return const struct variant_kernels* NULL if the shape is not built
+ */
+const struct variant_kernels *variant_find(const int width, const int unroll);
+
+#define VARIANT_HELP                                                           \
+  "  --variant-matrix            Copy, Axpy and Sum for vector widths 1 to "   \
+  "16 doubles\n"                                                               \
+  "                              times unroll factors 1 to 8, with samples "   \
+  "of --min-time.\n"                                                           \
+  "  --variant WxU               Run only the shape of width W and unroll U "  \
+  "(i.e. 8x2).\n"
+
+#define ISA_HELP                                                               \
+  "  --isa NAME|auto|all         Run the kernels built for one instruction "   \
+  "set, the\n"                                                                 \
+  "                              widest supported (auto) or every supported "  \
+  "one (all).\n"
+
+#endif
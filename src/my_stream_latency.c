@@ -0,0 +1,231 @@
+/**
+my_stream
+Copyright (C) 2023
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file my_stream_latency.c
+ * @author Simone Riva (you@domain.com)
+ * @brief Memory latency measured with a randomised cyclic pointer chain.
+ * @version 0.1
+ * @date 2023-12-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "my_stream_utils.h"
+
+/* default largest working set, in bytes */
+#define DEFAULT_MAX_SIZE (512UL * 1024 * 1024)
+
+#define DEFAULT_MIN_SIZE 4096UL
+
+#define BENCHMARK_REPETITIONS 5
+
+/* loads of a single timed chase */
+#define CHASE_LOADS (1UL << 22)
+
+/**
+ * @brief
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int main(const int argc, const char **argv) {
+
+  printf("Start My Stream [Latency]\n------------------------\n\n");
+
+#ifdef COMPILER
+  printf("Compiler: %s\n\n", COMPILER);
+#endif
+
+#ifdef ARCHITECTURE
+  printf("Architecture: %s\n\n", ARCHITECTURE);
+#endif
+
+  size_t max_size = DEFAULT_MAX_SIZE;
+  size_t min_size = DEFAULT_MIN_SIZE;
+  int benchmark_repetitions = BENCHMARK_REPETITIONS;
+
+  if (flag_exists(argc, argv, "-h") | flag_exists(argc, argv, "--help")) {
+
+    printf("Usage: %s [options]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h, --help                  Show this help message and exit.\n");
+    printf("  -s BYTES                    Largest working set, default 512 "
+           "MiB.\n");
+    printf("  --min-size BYTES            Smallest working set, default 4 "
+           "KiB.\n");
+    printf("  -r REPETITIONS              Number of repetitions of each "
+           "size.\n");
+    printf(BIND_POLICY_HELP);
+    printf(MEMBIND_HELP);
+    printf(PAGES_HELP);
+
+    printf("\n");
+    printf("Description:\n");
+    printf("  Builds a randomised cyclic chain of pointers, one per cache "
+           "line, over\n"
+           "  working sets from L1 to DRAM and reports the average time of a "
+           "dependent\n"
+           "  load in ns.\n"
+           "  Visit: https://github.com/simon-r/My_Stream_Benchmark \n");
+
+    printf("\n");
+    return 0;
+  }
+
+  const char *max_size_arg = find_command_line_arg_value(argc, argv, "-s");
+  if (max_size_arg != NULL) {
+    if (is_number(max_size_arg)) {
+      max_size = strtoul(max_size_arg, NULL, 10);
+      printf("User defined largest working set: %lu\n", max_size);
+    } else {
+      printf("Error: argument of -s is not numeric\n");
+      return 1;
+    }
+  }
+
+  const char *min_size_arg =
+      find_command_line_arg_value(argc, argv, "--min-size");
+  if (min_size_arg != NULL) {
+    if (is_number(min_size_arg)) {
+      min_size = strtoul(min_size_arg, NULL, 10);
+    } else {
+      printf("Error: argument of --min-size is not numeric\n");
+      return 1;
+    }
+  }
+
+  const char *benchmark_repetitions_arg =
+      find_command_line_arg_value(argc, argv, "-r");
+  if (benchmark_repetitions_arg != NULL) {
+    if (is_number(benchmark_repetitions_arg)) {
+      benchmark_repetitions = atoi(benchmark_repetitions_arg);
+      printf("User defined benchmark repetitions: %d\n", benchmark_repetitions);
+    } else {
+      printf("Error: argv -r is not numeric\n");
+      return 1;
+    }
+  }
+
+  int mem_node = -1;
+  const char *mem_node_arg = find_command_line_arg_value(argc, argv, "--membind");
+  if (mem_node_arg != NULL) {
+    if (is_number(mem_node_arg)) {
+      mem_node = atoi(mem_node_arg);
+    } else {
+      printf("Error: argument of --membind is not numeric\n");
+      return 1;
+    }
+  }
+
+  const int pages =
+      parse_page_mode(find_command_line_arg_value(argc, argv, "--pages"));
+  if (pages < 0) {
+    printf("Error: --pages must be 4k, thp, 2m or 1g\n");
+    return 1;
+  }
+
+  const char *bind_policy = find_command_line_arg_value(argc, argv, "--bind");
+  if (bind_policy == NULL) {
+    bind_policy = "compact";
+  }
+
+  int *cpus = make_cpu_binding(bind_policy, 1);
+  if (cpus == NULL) {
+    printf("Error: invalid --bind policy %s, or CPU not allowed\n",
+           bind_policy);
+    return 1;
+  }
+  if (bind_thread_to_cpu(pthread_self(), cpus[0]) != 0) {
+    printf("Error: cannot bind the thread with --bind %s\n", bind_policy);
+    free(cpus);
+    return 1;
+  }
+
+  if (min_size < CACHE_LINE_SIZE * 2) {
+    min_size = CACHE_LINE_SIZE * 2;
+  }
+
+  printf("\n-----------------------------------------------------------\n");
+  printf("Working sets:              %lu - %lu bytes\n", min_size, max_size);
+  printf("Loads per sample:          %lu\n", CHASE_LOADS);
+  printf("Repetitions:               %d\n", benchmark_repetitions);
+  printf("Pages:                     %s\n", page_mode_name(pages));
+  print_cpu_binding(bind_policy, cpus, 1);
+  printf("-----------------------------------------------------------\n\n");
+
+  printf("Working set           Mean [ns]       Min [ns]   Pages\n");
+  printf("-----------------------------------------------------------\n");
+
+  void *consume = NULL;
+  double *samples = malloc(benchmark_repetitions * sizeof(double));
+
+  for (size_t size = min_size; size <= max_size; size *= 2) {
+
+    void *chain = stream_mmap_alloc(size, mem_node, pages);
+    if (chain == NULL) {
+      printf("Error: cannot allocate %lu bytes\n", size);
+      return 1;
+    }
+
+    const size_t nr_lines = make_pointer_chain(chain, size, 1);
+
+    char pages_obtained[32];
+    describe_pages(chain, pages_obtained, sizeof(pages_obtained));
+
+    for (int r = 0; r < benchmark_repetitions; r++) {
+      struct timespec start, end;
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      consume = chase_pointers(chain, CHASE_LOADS);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      samples[r] = get_time(start, end) * 1.0e6 / (double)CHASE_LOADS;
+    }
+
+    if (size < 1024 * 1024) {
+      printf("%10.1f KiB    ", size / 1024.0);
+    } else {
+      printf("%10.1f MiB    ", size / to_MB);
+    }
+    printf("%12.2f   %12.2f   %-16s (%lu lines)\n",
+           average(samples, benchmark_repetitions),
+           minimum(samples, benchmark_repetitions), pages_obtained, nr_lines);
+    fflush(stdout);
+
+    stream_mmap_free(chain);
+  }
+
+  printf("-----------------------------------------------------------\n\n");
+  printf("consume %p (just an output)\n\n", consume);
+
+  free(samples);
+  free(cpus);
+
+  return 0;
+}
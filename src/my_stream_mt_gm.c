@@ -29,12 +29,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <omp.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include "my_stream_isa.h"
+#include "my_stream_nt.h"
+#include "my_stream_perf.h"
 #include "my_stream_utils.h"
 
 #define DEFAULT_TEST_SIZE 50000000
@@ -48,7 +51,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 typedef double float_type;
 
-sem_t semaphore;
+/* start gate of the timed regions */
+struct stream_barrier start_barrier;
+
+/* persistent workers, NULL when the threads are spawned at each repetition */
+struct stream_pool *pool = NULL;
+
+/* CPU of each thread, -1 when the thread is not pinned */
+int *thread_cpus = NULL;
+
+/* kernels of the default run without --isa, NULL for the compiled loops */
+const struct isa_kernels *default_isa = NULL;
 
 typedef float_type vector_type
     __attribute__((vector_size(VECTOR_LEN * sizeof(float_type)), //
@@ -63,40 +76,118 @@ struct streams_args {
   size_t start_index;
   size_t end_index;
 
+  int nt_store;
+
+  /* passes over the slice inside a single timed region */
+  size_t inner_repetitions;
+
+  /* software prefetch distance in cache lines (vectors), 0 for none */
+  size_t prefetch_distance;
+
+  /* kernels of an instruction set chosen with --isa, NULL for the default */
+  const struct isa_kernels *isa;
+
   double clock;
+  struct timespec start;
+  struct timespec end;
+
+  /* counters of the timed region, with --perf */
+  struct perf_values perf;
 };
 
+/**
+ * @brief Executes fun on nr_cpu threads, either on the persistent pool or on
+ * freshly created threads, using the same binding in both cases.
+ *
+ * @param fun
+ * @param nr_cpu
+ * @param threads_args array of nr_cpu arguments
+ * @param args_size size of a single argument
+ */
+void run_on_threads(void *fun(void *), const int nr_cpu, void *threads_args,
+                    const size_t args_size) {
+
+  if (pool != NULL) {
+    stream_pool_run(pool, fun, threads_args, args_size);
+    return;
+  }
+
+  /** make a vector of pthreads*/
+  pthread_t *threads = malloc(nr_cpu * sizeof(pthread_t));
+
+  for (int i = 0; i < nr_cpu; i++) {
+    if (create_bound_thread(&threads[i], fun,
+                            (char *)threads_args + i * args_size,
+                            thread_cpus[i]) != 0) {
+      // the threads already created would wait forever on the start barrier
+      printf("Error: cannot create a thread on CPU %d\n", thread_cpus[i]);
+      exit(1);
+    }
+  }
+
+  for (int i = 0; i < nr_cpu; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+}
+
 #define MAKE_BENCHMARK_FUNC(FUNC_NAME, BENCHMARK_FUN)                          \
   double FUNC_NAME(const size_t vec_size, const int nr_cpu,                    \
-                   struct streams_args *threads_args) {                        \
+                   struct streams_args *threads_args,                          \
+                   struct skew_stats *skew) {                                  \
                                                                                \
-    /** make a vector of pthreads*/                                            \
-    pthread_t *threads = malloc(nr_cpu * sizeof(pthread_t));                   \
-                                                                               \
-    /* Initialize semaphore*/                                                  \
-    sem_init(&semaphore, 0, nr_cpu);                                           \
-                                                                               \
-    for (int i = 0; i < nr_cpu; i++) {                                         \
-      pthread_create(&threads[i], NULL, BENCHMARK_FUN,                         \
-                     (void *)(&threads_args[i]));                              \
-    }                                                                          \
-                                                                               \
-    for (int i = 0; i < nr_cpu; i++) {                                         \
-      pthread_join(threads[i], NULL);                                          \
-    }                                                                          \
+    run_on_threads(BENCHMARK_FUN, nr_cpu, threads_args,                        \
+                   sizeof(struct streams_args));                               \
                                                                                \
     double average_time = 0;                                                   \
+    struct timespec *start = malloc(nr_cpu * sizeof(struct timespec));         \
+    struct timespec *end = malloc(nr_cpu * sizeof(struct timespec));           \
                                                                                \
     for (int i = 0; i < nr_cpu; i++) {                                         \
       average_time += threads_args[i].clock;                                   \
+      start[i] = threads_args[i].start;                                        \
+      end[i] = threads_args[i].end;                                            \
     }                                                                          \
                                                                                \
+    skew_stats_add(skew, start, end, nr_cpu);                                  \
+    free(start);                                                               \
+    free(end);                                                                 \
+                                                                               \
     average_time /= nr_cpu;                                                    \
                                                                                \
-    free(threads);                                                             \
     return average_time;                                                       \
   }
 
+/**
+ * @brief Initializes the slice [start_index, end_index) of the vectors, the
+ * pages are first touched by the thread which will stream them.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *init_thread(void *arg_void) {
+
+  struct streams_args *threads_args = (struct streams_args *)arg_void;
+
+  float_type *a = threads_args->a;
+  float_type *b = threads_args->b;
+  float_type *c = threads_args->c;
+  float_type *d = threads_args->d;
+
+  unsigned int r = generate_random_number(threads_args->start_index + 1);
+  for (size_t i = threads_args->start_index; i < threads_args->end_index;
+       i++) {
+    r = generate_random_number(r);
+    a[i] = 1.0 + (float_type)(r % 300) / 200.0;
+    b[i] = 1.0 + (float_type)(r % 400) / 300.0;
+    c[i] = 1.0 + (float_type)(r % 500) / 300.0;
+    d[i] = 0.0;
+  }
+
+  return NULL;
+}
+
 /**
  * @brief
  *
@@ -125,13 +216,41 @@ void *fma_thread(void *arg_void) {
 
   // printf("size_vec %d\n", size_vec);
 
-  sem_wait(&semaphore);
+  // opened before the barrier, started after it: neither the system calls
+  // of the open nor the wait are counted or timed
+  perf_thread_open();
+  stream_barrier_wait(&start_barrier);
 
+  perf_thread_start();
   clock_gettime(CLOCK_MONOTONIC, &start);
-  for (int i = 0; i < size_vec; i++) {
-    d_vec[i] = a_vec[i] * b_vec[i] + c_vec[i];
+  for (size_t n = 0; n < threads_args->inner_repetitions; n++) {
+    if (threads_args->nt_store) {
+      for (size_t i = 0; i < size_vec; i++) {
+        stream_nt_store((float_type *)&d_vec[i], a_vec[i] * b_vec[i] + c_vec[i]);
+      }
+      stream_nt_fence();
+    } else if (threads_args->isa != NULL) {
+      threads_args->isa->fma((float_type *)d_vec, (float_type *)a_vec,
+                             (float_type *)b_vec, (float_type *)c_vec,
+                             size_vec * VECTOR_LEN);
+    } else if (threads_args->prefetch_distance > 0) {
+      const size_t pd = threads_args->prefetch_distance;
+      for (size_t i = 0; i < size_vec; i++) {
+        __builtin_prefetch(&a_vec[i + pd], 0);
+        __builtin_prefetch(&b_vec[i + pd], 0);
+        __builtin_prefetch(&c_vec[i + pd], 0);
+        __builtin_prefetch(&d_vec[i + pd], 1);
+        d_vec[i] = a_vec[i] * b_vec[i] + c_vec[i];
+      }
+    } else {
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i] * b_vec[i] + c_vec[i];
+      }
+    }
+    __asm__ volatile("" ::: "memory");
   }
   clock_gettime(CLOCK_MONOTONIC, &end);
+  perf_thread_stop(&threads_args->perf);
 
   // Calculate elapsed time in milliseconds
 
@@ -142,6 +261,8 @@ void *fma_thread(void *arg_void) {
 
   // printf("Elapsed time: %lf milliseconds\n", elapsed);
   threads_args->clock = elapsed;
+  threads_args->start = start;
+  threads_args->end = end;
 
   return NULL;
 }
@@ -170,13 +291,38 @@ void *copy_thread(void *arg_void) {
 
   // printf("size_vec %d\n", size_vec);
 
-  sem_wait(&semaphore);
+  // opened before the barrier, started after it: neither the system calls
+  // of the open nor the wait are counted or timed
+  perf_thread_open();
+  stream_barrier_wait(&start_barrier);
 
+  perf_thread_start();
   clock_gettime(CLOCK_MONOTONIC, &start);
-  for (int i = 0; i < size_vec; i++) {
-    d_vec[i] = a_vec[i];
+  for (size_t n = 0; n < threads_args->inner_repetitions; n++) {
+    if (threads_args->nt_store) {
+      for (size_t i = 0; i < size_vec; i++) {
+        stream_nt_store((float_type *)&d_vec[i], a_vec[i]);
+      }
+      stream_nt_fence();
+    } else if (threads_args->isa != NULL) {
+      threads_args->isa->copy((float_type *)d_vec, (float_type *)a_vec,
+                              size_vec * VECTOR_LEN);
+    } else if (threads_args->prefetch_distance > 0) {
+      const size_t pd = threads_args->prefetch_distance;
+      for (size_t i = 0; i < size_vec; i++) {
+        __builtin_prefetch(&a_vec[i + pd], 0);
+        __builtin_prefetch(&d_vec[i + pd], 1);
+        d_vec[i] = a_vec[i];
+      }
+    } else {
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i];
+      }
+    }
+    __asm__ volatile("" ::: "memory");
   }
   clock_gettime(CLOCK_MONOTONIC, &end);
+  perf_thread_stop(&threads_args->perf);
 
   // Calculate elapsed time in milliseconds
 
@@ -188,6 +334,8 @@ void *copy_thread(void *arg_void) {
 
   // printf("Elapsed time: %lf milliseconds\n", elapsed);
   threads_args->clock = elapsed;
+  threads_args->start = start;
+  threads_args->end = end;
 
   return NULL;
 }
@@ -220,13 +368,40 @@ void *axpy_thread(void *arg_void) {
 
   // printf("size_vec %d\n", size_vec);
 
-  sem_wait(&semaphore);
+  // opened before the barrier, started after it: neither the system calls
+  // of the open nor the wait are counted or timed
+  perf_thread_open();
+  stream_barrier_wait(&start_barrier);
 
+  perf_thread_start();
   clock_gettime(CLOCK_MONOTONIC, &start);
-  for (int i = 0; i < size_vec; i++) {
-    d_vec[i] = alpha * a_vec[i] + b_vec[i];
+  for (size_t n = 0; n < threads_args->inner_repetitions; n++) {
+    if (threads_args->nt_store) {
+      for (size_t i = 0; i < size_vec; i++) {
+        stream_nt_store((float_type *)&d_vec[i], alpha * a_vec[i] + b_vec[i]);
+      }
+      stream_nt_fence();
+    } else if (threads_args->isa != NULL) {
+      threads_args->isa->axpy((float_type *)d_vec, (float_type *)a_vec,
+                              (float_type *)b_vec, alpha,
+                              size_vec * VECTOR_LEN);
+    } else if (threads_args->prefetch_distance > 0) {
+      const size_t pd = threads_args->prefetch_distance;
+      for (size_t i = 0; i < size_vec; i++) {
+        __builtin_prefetch(&a_vec[i + pd], 0);
+        __builtin_prefetch(&b_vec[i + pd], 0);
+        __builtin_prefetch(&d_vec[i + pd], 1);
+        d_vec[i] = alpha * a_vec[i] + b_vec[i];
+      }
+    } else {
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = alpha * a_vec[i] + b_vec[i];
+      }
+    }
+    __asm__ volatile("" ::: "memory");
   }
   clock_gettime(CLOCK_MONOTONIC, &end);
+  perf_thread_stop(&threads_args->perf);
 
   // Calculate elapsed time in milliseconds
 
@@ -237,6 +412,8 @@ void *axpy_thread(void *arg_void) {
 
   // printf("Elapsed time: %lf milliseconds\n", elapsed);
   threads_args->clock = elapsed;
+  threads_args->start = start;
+  threads_args->end = end;
 
   return NULL;
 }
@@ -263,14 +440,44 @@ void *add_mult_thread(void *arg_void) {
 
   // printf("size_vec %d\n", size_vec);
 
-  sem_wait(&semaphore);
+  // opened before the barrier, started after it: neither the system calls
+  // of the open nor the wait are counted or timed
+  perf_thread_open();
+  stream_barrier_wait(&start_barrier);
 
+  perf_thread_start();
   clock_gettime(CLOCK_MONOTONIC, &start);
-  for (int i = 0; i < size_vec; i++) {
-    d_vec[i] = a_vec[i] + b_vec[i];
-    c_vec[i] = a_vec[i] * b_vec[i];
+  for (size_t n = 0; n < threads_args->inner_repetitions; n++) {
+    if (threads_args->nt_store) {
+      for (size_t i = 0; i < size_vec; i++) {
+        stream_nt_store((float_type *)&d_vec[i], a_vec[i] + b_vec[i]);
+        stream_nt_store((float_type *)&c_vec[i], a_vec[i] * b_vec[i]);
+      }
+      stream_nt_fence();
+    } else if (threads_args->isa != NULL) {
+      threads_args->isa->add_mult((float_type *)d_vec, (float_type *)c_vec,
+                                  (float_type *)a_vec, (float_type *)b_vec,
+                                  size_vec * VECTOR_LEN);
+    } else if (threads_args->prefetch_distance > 0) {
+      const size_t pd = threads_args->prefetch_distance;
+      for (size_t i = 0; i < size_vec; i++) {
+        __builtin_prefetch(&a_vec[i + pd], 0);
+        __builtin_prefetch(&b_vec[i + pd], 0);
+        __builtin_prefetch(&c_vec[i + pd], 1);
+        __builtin_prefetch(&d_vec[i + pd], 1);
+        d_vec[i] = a_vec[i] + b_vec[i];
+        c_vec[i] = a_vec[i] * b_vec[i];
+      }
+    } else {
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i] + b_vec[i];
+        c_vec[i] = a_vec[i] * b_vec[i];
+      }
+    }
+    __asm__ volatile("" ::: "memory");
   }
   clock_gettime(CLOCK_MONOTONIC, &end);
+  perf_thread_stop(&threads_args->perf);
 
   // Calculate elapsed time in milliseconds
 
@@ -281,6 +488,8 @@ void *add_mult_thread(void *arg_void) {
 
   // printf("Elapsed time: %lf milliseconds\n", elapsed);
   threads_args->clock = elapsed;
+  threads_args->start = start;
+  threads_args->end = end;
 
   return NULL;
 }
@@ -293,104 +502,104 @@ MAKE_BENCHMARK_FUNC(fma_benchmark, fma_thread)
 
 MAKE_BENCHMARK_FUNC(add_mult_benchmark, add_mult_thread)
 
+/* NUMA node of the vectors, -1 for the default allocation */
+int mem_node = -1;
+
+/* pages backing the vectors, one of PAGES_* */
+int page_mode = PAGES_DEFAULT;
+
 void *stream_calloc(size_t __alignment, size_t vector_len, size_t type_size) {
+  if (mem_node >= 0 || page_mode != PAGES_DEFAULT) {
+    void *ptr = stream_mmap_alloc(vector_len * type_size, mem_node,
+                                  page_mode);
+    if (ptr == NULL) {
+      printf("Error: cannot allocate the vectors (NUMA node %d, %s pages)\n",
+             mem_node, page_mode_name(page_mode));
+      exit(1);
+    }
+    return ptr;
+  }
   return (void *)aligned_alloc(__alignment, vector_len * type_size);
 }
 
-/**
- * @brief
- *
- * @param argc
- * @param argv
- * @return int
- */
-int main(const int argc, const char **argv) {
-
-  printf("Start My Stream [Multi Threads - Global "
-         "Memory]\n------------------------\n\n");
-
-#ifdef COMPILER
-  printf("Compiler: %s\n\n", COMPILER);
-#endif
-
-#ifdef ARCHITECTURE
-  printf("Architecture: %s\n\n", ARCHITECTURE);
-#endif
+void stream_free(void *ptr) {
+  if (!stream_mmap_free(ptr)) {
+    free(ptr);
+  }
+}
 
-  size_t vec_size = DEFAULT_TEST_SIZE;
-  int benchmark_repetitions = BENCHMARK_REPETITIONS;
+#define NR_KERNELS 4
 
-  if (flag_exists(argc, argv, "-h") | flag_exists(argc, argv, "--help")) {
+typedef double benchmark_func(const size_t, const int, struct streams_args *,
+                              struct skew_stats *);
 
-    printf("Usage: %s [options]\n", argv[0]);
-    printf("Options:\n");
-    printf("  -h, --help                  Show this help message and exit.\n");
-    printf("  -s SIZE                     Size of the vector.\n");
-    printf("  -r REPETITIONS              Number of repetitions of each "
-           "benchmark.\n");
+struct kernel_info {
+  const char *name;
+  const char *id;
+  benchmark_func *benchmark;
+  int nr_streams;
+};
 
-    printf("\n");
-    printf("Description:\n");
-    printf("  This program,  \"my_stream\" "
-           ", is designed to benchmark the memory bandwidth (in MB/s and "
-           "GB/s). \n"
-           "  In order to measure the bandwidth, it executes four "
-           "\"memory bound\" vector operations: Axpy, Copy, FMA (fused "
-           "multiply-add), and Add Mult..\n"
-           "  Visit: https://github.com/simon-r/My_Stream_Benchmark \n");
+const struct kernel_info kernels[NR_KERNELS] = {
+    {"Axpy", "axpy", axpy_benchmark, 3},
+    {"Copy", "copy", copy_benchmark, 2},
+    {"FMA", "fma", fma_benchmark, 4},
+    {"Add Mult", "add_mult", add_mult_benchmark, 4},
+};
 
-    printf("\n");
-    return 0;
+/**
+ * @brief Places the nr_cpu threads of a sweep step with the binding policy
+ * and, unless they are spawned at each repetition, starts their pool.
+ * Exits when a thread cannot be placed or created.
+ *
+ * @param bind_policy
+ * @param nr_cpu
+ * @param spawn_threads
+ */
+void sweep_threads_begin(const char *bind_policy, const int nr_cpu,
+                         const int spawn_threads) {
+  thread_cpus = make_cpu_binding(bind_policy, nr_cpu);
+  if (thread_cpus == NULL) {
+    printf("Error: invalid --bind policy %s for %d threads\n", bind_policy,
+           nr_cpu);
+    exit(1);
   }
 
-  const char *vec_size_arg = find_command_line_arg_value(argc, argv, "-s");
-
-  if (vec_size_arg != NULL) {
-
-    if (is_number(vec_size_arg)) {
-      vec_size = strtoul(vec_size_arg, NULL, 10);
-      printf("User defined vector size: %lu\n", vec_size);
-    } else {
-      printf("Error: argument of -s is not numeric\n");
-      return 1;
-    }
-  }
+  stream_barrier_init(&start_barrier, nr_cpu);
 
-  const char *benchmark_repetitions_arg =
-      find_command_line_arg_value(argc, argv, "-r");
+  if (!spawn_threads) {
+    pool = stream_pool_create(nr_cpu, thread_cpus);
 
-  if (benchmark_repetitions_arg != NULL) {
-    if (is_number(benchmark_repetitions_arg)) {
-      benchmark_repetitions = atoi(benchmark_repetitions_arg);
-      printf("User defined benchmark repetitions: %d\n", benchmark_repetitions);
-    } else {
-      printf("Error: argv -r is not numeric\n");
-      return 1;
+    if (pool == NULL) {
+      printf("Error: cannot create the thread pool\n");
+      exit(1);
     }
   }
+}
 
-  // get the number of cpu from open mp
-  const int nr_cpu = omp_get_num_procs();
-  vec_size = vec_size / nr_cpu;
-  vec_size = ((vec_size - vec_size % VECTOR_LEN) + VECTOR_LEN) * nr_cpu;
-
-  // double to_MB = (1024.0 * 1024.0);
-  // double to_GB = (1024.0 * 1024.0 * 1024.0);
-
-  double bytes_vec_size = (double)(vec_size * sizeof(float_type));
-  double MB_vec_size = bytes_vec_size / to_MB;
-  double GB_vec_size = bytes_vec_size / to_GB;
+/**
+ * @brief Stops the threads of a sweep step started by sweep_threads_begin.
+ */
+void sweep_threads_end(void) {
+  stream_pool_destroy(pool);
+  pool = NULL;
+  free(thread_cpus);
+  thread_cpus = NULL;
+}
 
-  printf("\n-----------------------------------------------------------\n");
-  printf("Number of CPU:             %d\n", nr_cpu);
-  printf("Adjusted vector size:      %lu\n", vec_size);
-  printf("MB Vector size:            %f\n", MB_vec_size);
-  printf("GB Vector size:            %f\n", GB_vec_size);
-  printf("GB Total allocated memory: %f\n", GB_vec_size * 4);
-  printf("Repetitions:               %d\n", benchmark_repetitions);
-  printf("-----------------------------------------------------------\n\n");
+/**
+ * @brief Allocates the four vectors of a sweep step, nr_cpu slices of
+ * batch_vec_size elements, first touched by the threads of the step.
+ *
+ * @param batch_vec_size a multiple of VECTOR_LEN
+ * @param nr_cpu
+ * @return struct streams_args* the arguments of the threads, to be released
+ * with sweep_vectors_free
+ */
+struct streams_args *sweep_vectors_alloc(const size_t batch_vec_size,
+                                         const int nr_cpu) {
+  const size_t vec_size = batch_vec_size * nr_cpu;
 
-  // malloc a aligned to 4 * sizeof(float_type)
   float_type *a = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
                                               vec_size, sizeof(float_type));
   float_type *b = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
@@ -400,18 +609,7 @@ int main(const int argc, const char **argv) {
   float_type *d = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
                                               vec_size, sizeof(float_type));
 
-  unsigned int r = 1;
-  for (int i = 0; i < vec_size; i++) {
-    r = generate_random_number(r);
-    a[i] = 1.0 + (float_type)(r % 300) / 200.0;
-    b[i] = 1.0 + (float_type)(r % 400) / 300.0;
-    c[i] = 1.0 + (float_type)(r % 500) / 300.0;
-    d[i] = 0.0;
-  }
-
-  struct streams_args *th_args = malloc(nr_cpu * sizeof(struct streams_args));
-
-  size_t batch_vec_size = vec_size / nr_cpu;
+  struct streams_args *th_args = calloc(nr_cpu, sizeof(struct streams_args));
 
   for (int i = 0; i < nr_cpu; i++) {
     th_args[i].a = a;
@@ -420,174 +618,3281 @@ int main(const int argc, const char **argv) {
     th_args[i].d = d;
     th_args[i].start_index = i * batch_vec_size;
     th_args[i].end_index = (i + 1) * batch_vec_size;
+    th_args[i].nt_store = 0;
+    th_args[i].inner_repetitions = 1;
   }
 
-  double consume = 0.0;
-  double average_axpy_time = 0.0;
+  run_on_threads(init_thread, nr_cpu, th_args, sizeof(struct streams_args));
+
+  return th_args;
+}
+
+/**
+ * @brief Releases the vectors and the arguments of sweep_vectors_alloc.
+ *
+ * @param th_args
+ */
+void sweep_vectors_free(struct streams_args *th_args) {
+  stream_free(th_args[0].a);
+  stream_free(th_args[0].b);
+  stream_free(th_args[0].c);
+  stream_free(th_args[0].d);
+  free(th_args);
+}
+
+/**
+ * @brief Runs the four kernels with the threads pinned on the CPUs of node X
+ * and the vectors bound to node Y, for every pair (X, Y), and prints a
+ * bandwidth matrix per kernel. Memory only nodes appear as columns.
+ *
+ * @param vec_size
+ * @param benchmark_repetitions
+ * @param spawn_threads
+ * @return int
+ */
+int numa_matrix(const size_t vec_size, const int benchmark_repetitions,
+                const int spawn_threads) {
+
+  int *nodes;
+  const int nr_nodes = numa_nodes(&nodes);
 
-  for (int i = 0; i < benchmark_repetitions; i++) {
-    average_axpy_time += axpy_benchmark(vec_size, nr_cpu, th_args);
-    consume += a[100] + b[1002] + c[1002] + d[1002];
+  // bandwidth[kernel][cpu node][memory node] in GB/s, negative when the
+  // memory of the node cannot be allocated
+  double *bandwidth = malloc(NR_KERNELS * nr_nodes * nr_nodes * sizeof(double));
+  for (int i = 0; i < NR_KERNELS * nr_nodes * nr_nodes; i++) {
+    bandwidth[i] = -1.0;
   }
 
-  average_axpy_time /= (double)(benchmark_repetitions);
+  int *saved_cpus = thread_cpus;
+
+  for (int x = 0; x < nr_nodes; x++) {
+
+    // only the allowed CPUs, a node without any is skipped
+    int *cpus;
+    const int nr_cpu = numa_node_cpus(nodes[x], &cpus);
+
+    if (nr_cpu <= 0) {
+      free(cpus);
+      continue;
+    }
+
+    size_t batch_vec_size = vec_size / nr_cpu;
+    batch_vec_size = (batch_vec_size - batch_vec_size % VECTOR_LEN) + VECTOR_LEN;
+    const size_t node_vec_size = batch_vec_size * nr_cpu;
 
-  double memory_streamed_axpy_MB =
-      (3.0 * batch_vec_size * nr_cpu * sizeof(float_type)) / to_MB *
-      benchmark_repetitions;
-  // double memory_streamed_axpy_GB =
-  //     (3.0 * batch_vec_size * nr_cpu * sizeof(float_type)) / to_GB *
-  //     benchmark_repetitions;
+    thread_cpus = cpus;
+    stream_barrier_init(&start_barrier, nr_cpu);
 
-  double bandwidth_axpy = (3.0 * batch_vec_size * nr_cpu * sizeof(float_type)) /
-                          (average_axpy_time / 1000.0);
+    if (!spawn_threads) {
+      pool = stream_pool_create(nr_cpu, cpus);
 
-  // double bandwidth_axpy_MBS = bandwidth_axpy / to_MB;
-  double bandwidth_axpy_GBS = bandwidth_axpy / to_GB;
+      if (pool == NULL) {
+        printf("Error: cannot create the thread pool\n");
+        exit(1);
+      }
+    }
 
-#ifdef VERBOSE
-  printf("Average axpy Time: %lf\n", average_axpy_time);
-  printf("Bandwidth axpy: %lf MB/s\n", bandwidth_axpy_MBS);
-  printf("Bandwidth axpy: %lf GB/s\n", bandwidth_axpy_GBS);
-#endif // VERBOSE
+    struct streams_args *th_args = calloc(nr_cpu, sizeof(struct streams_args));
+
+    for (int y = 0; y < nr_nodes; y++) {
+
+      const size_t bytes = node_vec_size * sizeof(float_type);
+      float_type *a = stream_mmap_alloc(bytes, nodes[y], page_mode);
+      float_type *b = stream_mmap_alloc(bytes, nodes[y], page_mode);
+      float_type *c = stream_mmap_alloc(bytes, nodes[y], page_mode);
+      float_type *d = stream_mmap_alloc(bytes, nodes[y], page_mode);
+
+      if (a && b && c && d) {
+        for (int i = 0; i < nr_cpu; i++) {
+          th_args[i].a = a;
+          th_args[i].b = b;
+          th_args[i].c = c;
+          th_args[i].d = d;
+          th_args[i].start_index = i * batch_vec_size;
+          th_args[i].end_index = (i + 1) * batch_vec_size;
+          th_args[i].nt_store = 0;
+          th_args[i].inner_repetitions = 1;
+        }
+
+        run_on_threads(init_thread, nr_cpu, th_args,
+                       sizeof(struct streams_args));
+
+        for (int k = 0; k < NR_KERNELS; k++) {
+          struct skew_stats skew = {0};
+          double average_time = 0.0;
+
+          for (int r = 0; r < benchmark_repetitions; r++) {
+            average_time +=
+                kernels[k].benchmark(node_vec_size, nr_cpu, th_args, &skew);
+          }
+          average_time /= (double)benchmark_repetitions;
+
+          bandwidth[(k * nr_nodes + x) * nr_nodes + y] =
+              compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                                average_time, sizeof(float_type)) /
+              to_GB;
+        }
+      }
+
+      stream_mmap_free(a);
+      stream_mmap_free(b);
+      stream_mmap_free(c);
+      stream_mmap_free(d);
+    }
 
-  // printf("Consume axpy: %lf\n", consume);
-  // printf("-----------------------------------------------------------\n\n");
+    free(th_args);
+    stream_pool_destroy(pool);
+    pool = NULL;
+    free(cpus);
 
-  double average_copy_time = 0.0;
-  for (int i = 0; i < benchmark_repetitions; i++) {
-    average_copy_time += copy_benchmark(vec_size, nr_cpu, th_args);
-    consume += a[100] + b[1002] + c[1002] + d[1002];
+    printf("CPU node %d done (%d threads)\n", nodes[x], nr_cpu);
   }
-  average_copy_time /= (double)(benchmark_repetitions);
 
-  double memory_streamed_copy_MB =
-      (2.0 * batch_vec_size * nr_cpu * sizeof(float_type)) / to_MB *
-      benchmark_repetitions;
-  // double memory_streamed_copy_GB =
-  //     (2.0 * batch_vec_size * nr_cpu * sizeof(float_type)) / to_GB *
-  //     benchmark_repetitions;
+  thread_cpus = saved_cpus;
+
+  printf("\nNUMA bandwidth matrix [GB/s], rows: CPU node, columns: memory "
+         "node\n");
 
-  double bandwidth_copy = (2.0 * batch_vec_size * nr_cpu * sizeof(float_type)) /
-                          (average_copy_time / 1000.0);
+  for (int k = 0; k < NR_KERNELS; k++) {
+    printf("\n%s:\n", kernels[k].name);
+    printf("%-10s", "CPU\\Mem");
+    for (int y = 0; y < nr_nodes; y++) {
+      printf("%10d", nodes[y]);
+    }
+    printf("\n");
+
+    for (int x = 0; x < nr_nodes; x++) {
+      int *cpus;
+      const int has_cpus = numa_node_cpus(nodes[x], &cpus) > 0;
+      free(cpus);
+
+      if (!has_cpus) {
+        continue;
+      }
+
+      printf("%-10d", nodes[x]);
+      for (int y = 0; y < nr_nodes; y++) {
+        const double bw = bandwidth[(k * nr_nodes + x) * nr_nodes + y];
+        if (bw < 0.0) {
+          printf("%10s", "-");
+        } else {
+          printf("%10.2f", bw);
+        }
+      }
+      printf("\n");
+    }
+  }
+  printf("\n");
 
-  // double bandwidth_copy_MBS = bandwidth_copy / to_MB;
-  double bandwidth_copy_GBS = bandwidth_copy / to_GB;
+  free(bandwidth);
+  free(nodes);
 
-#ifdef VERBOSE
-  printf("Average Copy Time: %lf\n", average_copy_time);
-  printf("Bandwidth copy: %lf MB/s\n", bandwidth_copy_MBS);
-  printf("Bandwidth copy: %lf GB/s\n", bandwidth_copy_GBS);
-#endif // VERBOSE
+  return 0;
+}
 
-  double average_fma_time = 0.0;
-  for (int i = 0; i < benchmark_repetitions; i++) {
-    average_fma_time += fma_benchmark(vec_size, nr_cpu, th_args);
-    consume += a[100] + b[1002] + c[1002] + d[1002];
+/**
+ * @brief Runs the kernels over geometrically spaced working sets, from
+ * min_bytes up to the size of the four vectors given with -s, and prints a
+ * size -> GB/s table. The working set is the size of the four vectors.
+ * Small sizes repeat the kernel inside the timed region (inner repetitions)
+ * so that every sample lasts at least min_time ms.
+ *
+ * @param max_vec_size
+ * @param min_bytes
+ * @param min_time
+ * @param benchmark_repetitions
+ * @param nr_cpu
+ * @param nt_store
+ * @return int
+ */
+int cache_sweep(const size_t max_vec_size, const size_t min_bytes,
+                const double min_time, const int benchmark_repetitions,
+                const int nr_cpu, const int nt_store) {
+
+  struct streams_args *th_args = calloc(nr_cpu, sizeof(struct streams_args));
+
+  printf("Working set sweep, %d threads%s, samples of at least %.1f ms\n",
+         nr_cpu, nt_store ? ", non-temporal stores" : "", min_time);
+  printf("-----------------------------------------------------------------"
+         "-------------\n");
+  printf("Working set       Inner reps ");
+  for (int k = 0; k < NR_KERNELS; k++) {
+    printf("%10s", kernels[k].name);
   }
-  average_fma_time /= (double)(benchmark_repetitions);
+  printf("   [GB/s]\n");
+  printf("-----------------------------------------------------------------"
+         "-------------\n");
+
+  const size_t max_bytes = 4 * max_vec_size * sizeof(float_type);
+
+  for (size_t bytes = min_bytes; bytes <= max_bytes; bytes *= 2) {
+
+    // per thread slice, rounded to a multiple of VECTOR_LEN
+    size_t batch_vec_size = bytes / (4 * sizeof(float_type)) / nr_cpu;
+    batch_vec_size -= batch_vec_size % VECTOR_LEN;
+
+    if (batch_vec_size == 0) {
+      continue;
+    }
+
+    const size_t vec_size = batch_vec_size * nr_cpu;
+
+    float_type *a = (float_type *)stream_calloc(
+        VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+    float_type *b = (float_type *)stream_calloc(
+        VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+    float_type *c = (float_type *)stream_calloc(
+        VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+    float_type *d = (float_type *)stream_calloc(
+        VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+
+    for (int i = 0; i < nr_cpu; i++) {
+      th_args[i].a = a;
+      th_args[i].b = b;
+      th_args[i].c = c;
+      th_args[i].d = d;
+      th_args[i].start_index = i * batch_vec_size;
+      th_args[i].end_index = (i + 1) * batch_vec_size;
+      th_args[i].nt_store = nt_store;
+      th_args[i].inner_repetitions = 1;
+    }
+
+    run_on_threads(init_thread, nr_cpu, th_args,
+                   sizeof(struct streams_args));
+
+    // calibration on the first kernel: scale the inner repetitions until a
+    // sample is long enough, then use them for all the kernels
+    struct skew_stats skew = {0};
+    size_t inner_repetitions = 1;
 
-  double memory_streamed_fma_MB =
-      (4.0 * batch_vec_size * nr_cpu * sizeof(float_type)) / to_MB *
-      benchmark_repetitions;
+    for (;;) {
+      for (int i = 0; i < nr_cpu; i++) {
+        th_args[i].inner_repetitions = inner_repetitions;
+      }
 
-  // double memory_streamed_fma_GB =
-  //     (4.0 * batch_vec_size * nr_cpu * sizeof(float_type)) / to_GB *
-  //     benchmark_repetitions;
+      const double t = kernels[0].benchmark(vec_size, nr_cpu, th_args, &skew);
+      if (t >= min_time) {
+        break;
+      }
 
-  double bandwidth_fma = (4.0 * batch_vec_size * nr_cpu * sizeof(float_type)) /
-                         (average_fma_time / 1000.0);
+      const double scale = t > 0.0 ? min_time / t : 1024.0;
+      inner_repetitions *= scale > 2.0 ? (size_t)(scale + 1.0) : 2;
+    }
+
+    double bandwidth[NR_KERNELS];
 
-  // double bandwidth_fma_MBS = bandwidth_fma / to_MB;
-  double bandwidth_fma_GBS = bandwidth_fma / to_GB;
+    for (int k = 0; k < NR_KERNELS; k++) {
+      double average_time = 0.0;
+      for (int r = 0; r < benchmark_repetitions; r++) {
+        average_time += kernels[k].benchmark(vec_size, nr_cpu, th_args, &skew);
+      }
+      average_time /= (double)benchmark_repetitions;
+
+      bandwidth[k] = compute_bandwidth(nr_cpu, kernels[k].nr_streams,
+                                       batch_vec_size * inner_repetitions,
+                                       average_time, sizeof(float_type)) /
+                     to_GB;
+    }
 
-#ifdef VERBOSE
-  printf("Average FMA Time: %lf\n", average_fma_time);
-  printf("Bandwidth fma: %lf MB/s\n", bandwidth_fma_MBS);
-  printf("Bandwidth fma: %lf GB/s\n", bandwidth_fma_GBS);
-#endif // VERBOSE
+    const size_t set_bytes = 4 * vec_size * sizeof(float_type);
+    if (set_bytes < 1024 * 1024) {
+      printf("%10.1f KiB  %12lu ", set_bytes / 1024.0, inner_repetitions);
+    } else {
+      printf("%10.1f MiB  %12lu ", set_bytes / to_MB, inner_repetitions);
+    }
+    for (int k = 0; k < NR_KERNELS; k++) {
+      printf("%10.2f", bandwidth[k]);
+    }
+    printf("\n");
+    fflush(stdout);
 
-  double average_add_mult_time = 0.0;
-  for (int i = 0; i < benchmark_repetitions; i++) {
-    average_add_mult_time += add_mult_benchmark(vec_size, nr_cpu, th_args);
-    consume += a[100] + b[1002] + c[1002] + d[1002];
+    stream_free(a);
+    stream_free(b);
+    stream_free(c);
+    stream_free(d);
   }
-  average_add_mult_time /= (double)(benchmark_repetitions);
 
-  double memory_streamed_add_mult_MB =
-      (4.0 * batch_vec_size * nr_cpu * sizeof(float_type)) / to_MB *
-      benchmark_repetitions;
+  printf("-----------------------------------------------------------------"
+         "-------------\n\n");
 
-  // double memory_streamed_add_mult_GB =
-  //     (4.0 * batch_vec_size * nr_cpu * sizeof(float_type)) / to_GB *
-  //     benchmark_repetitions;
+  free(th_args);
 
-  double bandwidth_add_mult =
-      (4.0 * batch_vec_size * nr_cpu * sizeof(float_type)) /
-      (average_add_mult_time / 1000.0);
+  return 0;
+}
 
-  // double bandwidth_add_mult_MBS = bandwidth_add_mult / to_MB;
-  double bandwidth_add_mult_GBS = bandwidth_add_mult / to_GB;
+/* roles of the threads in the loaded latency mode */
+#define LOADED_PROBE 0
+#define LOADED_IDLE 1
+#define LOADED_COPY 2
+#define LOADED_AXPY 3
 
-#ifdef VERBOSE
-  printf("Average Add Mult Time: %lf\n", average_add_mult_time);
-  printf("Bandwidth add mult: %lf MB/s\n", bandwidth_add_mult_MBS);
-  printf("Bandwidth add mult: %lf GB/s\n", bandwidth_add_mult_GBS);
-#endif // VERBOSE
+/* vectors streamed by a load thread between two delays (16 KiB per stream) */
+#define LOADED_CHUNK 256
 
-#define SEP                                                                    \
-  "--------------------------------------------------------------------------" \
-  "---------------------"                                                      \
-  "\n\n"
+/* dependent loads of the latency probe at each delay */
+#define LOADED_CHASE_LOADS (1UL << 22)
 
-  printf(SEP);
+struct loaded_args {
+  struct streams_args stream;
 
-  printf("consume %f (just an output)\n", consume);
+  int role;
 
-  printf(SEP);
+  /* empty iterations after each chunk, throttles the load threads */
+  size_t delay;
+
+  /* set by the probe when it is done, stops the load threads */
+  int *stop;
+
+  /* probe: chain, last line reached and ns per load */
+  void *chain;
+  size_t chain_bytes;
+  void *consume;
+  double latency;
 
-  // printf("Results:\n");
-  // printf(SEP);
-  // printf("Benchmark:            GB/s                 Memory "
-  //        "Streamed [MB]\n");
-  // printf(SEP);
-  // printf("Axpy:       %15.2lf [GB/s]         %lf\n",   //
-  //        bandwidth_axpy_GBS, memory_streamed_axpy_MB); //
+  /* load threads: bytes streamed in stream.clock ms */
+  double bytes;
+};
 
-  // printf("Copy:       %15.2lf [GB/s]         %lf\n",   //
-  //        bandwidth_copy_GBS, memory_streamed_copy_MB); //
+/**
+ * @brief Builds the pointer chain on the probe thread, so that its pages are
+ * first touched where they are read.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *loaded_chain_thread(void *arg_void) {
 
-  // printf("FMA:        %15.2lf [GB/s]         %lf\n", //
-  //        bandwidth_fma_GBS, memory_streamed_fma_MB); //
+  struct loaded_args *args = (struct loaded_args *)arg_void;
 
-  // printf("Add Mult:   %15.2lf [GB/s]         %lf\n",           //
-  //        bandwidth_add_mult_GBS, memory_streamed_add_mult_MB); //
+  if (args->role == LOADED_PROBE) {
+    make_pointer_chain(args->chain, args->chain_bytes, 1);
+  }
 
-  printf("Results:\n");
-  printf(SEP);
-  printf("Benchmark:            GB/s                 Memory Streamed [MB]      "
-         "Avg. Clock [ms]\n");
-  printf(SEP);
-  printf("Axpy:       %15.2lf [GB/s]         %lf                 %lf\n",  //
-         bandwidth_axpy_GBS, memory_streamed_axpy_MB, average_axpy_time); //
+  return NULL;
+}
 
-  printf("Copy:       %15.2lf [GB/s]         %lf                 %lf\n",  //
-         bandwidth_copy_GBS, memory_streamed_copy_MB, average_copy_time); //
+/**
+ * @brief The probe chases the pointer chain, the other threads run copy or
+ * axpy over their slice, chunk by chunk, until the probe is done.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *loaded_latency_thread(void *arg_void) {
 
-  printf("FMA:        %15.2lf [GB/s]         %lf                 %lf\n", //
-         bandwidth_fma_GBS, memory_streamed_fma_MB, average_fma_time);   //
+  struct loaded_args *args = (struct loaded_args *)arg_void;
 
-  printf("Add Mult:   %15.2lf [GB/s]         %lf                 %lf\n", //
-         bandwidth_add_mult_GBS, memory_streamed_add_mult_MB,
-         average_add_mult_time); //
+  const float_type alpha = 2.55;
 
-  printf(SEP);
+  vector_type *a_vec =
+      (vector_type *)(args->stream.a + args->stream.start_index);
+  vector_type *b_vec =
+      (vector_type *)(args->stream.b + args->stream.start_index);
+  vector_type *d_vec =
+      (vector_type *)(args->stream.d + args->stream.start_index);
 
-  free(a);
-  free(b);
-  free(c);
-  free(d);
-  free(th_args);
+  const size_t size_vec =
+      (args->stream.end_index - args->stream.start_index) / VECTOR_LEN;
+
+  struct timespec start, end;
+
+  stream_barrier_wait(&start_barrier);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (args->role == LOADED_PROBE) {
+    args->consume = chase_pointers(args->chain, LOADED_CHASE_LOADS);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    __atomic_store_n(args->stop, 1, __ATOMIC_RELEASE);
+
+    args->latency = get_time(start, end) * 1.0e6 / (double)LOADED_CHASE_LOADS;
+    return NULL;
+  }
+
+  size_t vectors = 0;
+  size_t i = 0;
+
+  while (args->role != LOADED_IDLE &&
+         !__atomic_load_n(args->stop, __ATOMIC_ACQUIRE)) {
+
+    const size_t chunk_end =
+        i + LOADED_CHUNK < size_vec ? i + LOADED_CHUNK : size_vec;
+
+    vectors += chunk_end - i;
+
+    if (args->role == LOADED_COPY) {
+      for (; i < chunk_end; i++) {
+        d_vec[i] = a_vec[i];
+      }
+    } else {
+      for (; i < chunk_end; i++) {
+        d_vec[i] = alpha * a_vec[i] + b_vec[i];
+      }
+    }
+
+    if (i == size_vec) {
+      i = 0;
+    }
+
+    for (size_t j = 0; j < args->delay; j++) {
+      __asm__ volatile("" ::: "memory");
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  const int nr_streams = args->role == LOADED_COPY ? 2 : 3;
+
+  args->stream.clock = get_time(start, end);
+  args->bytes =
+      (double)vectors * VECTOR_LEN * sizeof(float_type) * (double)nr_streams;
+
+  return NULL;
+}
+
+/**
+ * @brief Loaded latency: thread 0 measures the latency of a pointer chase
+ * while the other threads stream copy or axpy, throttled by a delay after each
+ * chunk. Every delay gives a point of the latency vs bandwidth curve, the
+ * first row is measured without load.
+ *
+ * @param vec_size
+ * @param chain_bytes
+ * @param nr_cpu
+ * @param role LOADED_COPY or LOADED_AXPY
+ * @param delays
+ * @param nr_delays
+ * @return int
+ */
+int loaded_latency(const size_t vec_size, const size_t chain_bytes,
+                   const int nr_cpu, const int role, const size_t *delays,
+                   const int nr_delays) {
+
+  const int nr_load = nr_cpu - 1;
+
+  size_t batch_vec_size = nr_load > 0 ? vec_size / nr_load : 0;
+  batch_vec_size -= batch_vec_size % VECTOR_LEN;
+
+  float_type *a = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              vec_size, sizeof(float_type));
+  float_type *b = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              vec_size, sizeof(float_type));
+  float_type *c = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              vec_size, sizeof(float_type));
+  float_type *d = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              vec_size, sizeof(float_type));
+
+  void *chain = stream_mmap_alloc(chain_bytes, mem_node, page_mode);
+  if (chain == NULL) {
+    printf("Error: cannot allocate the pointer chain\n");
+    stream_free(a);
+    stream_free(b);
+    stream_free(c);
+    stream_free(d);
+    return 1;
+  }
+
+  int stop = 0;
+
+  struct loaded_args *args = calloc(nr_cpu, sizeof(struct loaded_args));
+
+  for (int i = 0; i < nr_cpu; i++) {
+    args[i].stream.a = a;
+    args[i].stream.b = b;
+    args[i].stream.c = c;
+    args[i].stream.d = d;
+
+    // the probe has no slice, load thread i streams slice i - 1
+    const size_t slice = i > 0 ? i - 1 : 0;
+    args[i].stream.start_index = slice * batch_vec_size;
+    args[i].stream.end_index = i > 0 ? (slice + 1) * batch_vec_size : 0;
+
+    args[i].role = i == 0 ? LOADED_PROBE : role;
+    args[i].stop = &stop;
+    args[i].chain = chain;
+    args[i].chain_bytes = chain_bytes;
+  }
+
+  struct streams_args *th_args = calloc(nr_cpu, sizeof(struct streams_args));
+  for (int i = 0; i < nr_cpu; i++) {
+    th_args[i] = args[i].stream;
+  }
+  // the probe slice is empty, the load threads touch their own pages
+  run_on_threads(init_thread, nr_cpu, th_args, sizeof(struct streams_args));
+  free(th_args);
+
+  run_on_threads(loaded_chain_thread, nr_cpu, args,
+                 sizeof(struct loaded_args));
+
+  printf("Loaded latency: 1 probe thread, %d %s threads, chain of %.1f MiB\n",
+         nr_load, role == LOADED_COPY ? "copy" : "axpy", chain_bytes / to_MB);
+  printf("-----------------------------------------------------------\n");
+  printf("Delay [iter]      Bandwidth [GB/s]      Latency [ns]\n");
+  printf("-----------------------------------------------------------\n");
+
+  void *consume = NULL;
+
+  // -1: no load, then from the largest delay to the smallest
+  for (int n = -1; n < nr_delays; n++) {
+
+    stop = 0;
+    for (int i = 1; i < nr_cpu; i++) {
+      args[i].role = n < 0 ? LOADED_IDLE : role;
+      args[i].delay = n < 0 ? 0 : delays[n];
+    }
+
+    run_on_threads(loaded_latency_thread, nr_cpu, args,
+                   sizeof(struct loaded_args));
+
+    consume = args[0].consume;
+
+    double bandwidth = 0.0;
+    for (int i = 1; i < nr_cpu; i++) {
+      if (args[i].stream.clock > 0.0) {
+        bandwidth += args[i].bytes / args[i].stream.clock * 1000.0;
+      }
+    }
+
+    if (n < 0) {
+      printf("%-12s", "idle");
+    } else {
+      printf("%-12lu", delays[n]);
+    }
+    printf("  %20.2f  %16.2f\n", bandwidth / to_GB, args[0].latency);
+    fflush(stdout);
+  }
+
+  printf("-----------------------------------------------------------\n");
+  printf("consume %p (just an output)\n\n", consume);
+
+  free(args);
+  stream_mmap_free(chain);
+  stream_free(a);
+  stream_free(b);
+  stream_free(c);
+  stream_free(d);
+
+  return 0;
+}
+
+/* independent FMA chains in flight per thread, enough to hide the latency */
+#define ROOFLINE_CHAINS 8
+#define ROOFLINE_PEAK_CHAINS 16
+
+/* iterations of the compute only run, about 4 GFLOP per thread */
+#define ROOFLINE_PEAK_ITERATIONS (1UL << 24)
+
+struct roofline_args {
+  struct streams_args stream;
+
+  /* dependent FMAs per loaded element, 0 for the compute only run */
+  int fmas;
+
+  /* given at run time: with constants -Ofast folds x * 0.5 + 0.5 into
+     (x + 1) * 0.5, an add and a mul instead of an FMA */
+  float_type alpha;
+  float_type beta;
+
+  float_type consume;
+};
+
+/**
+ * @brief Loads a, applies fmas dependent FMAs to each element and stores the
+ * result in d: 2 * fmas flop per 16 bytes moved. ROOFLINE_CHAINS vectors are
+ * processed together so that the chains overlap. With fmas == 0 the thread
+ * runs the compute only peak on registers.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *roofline_thread(void *arg_void) {
+
+  struct roofline_args *args = (struct roofline_args *)arg_void;
+
+  vector_type *a_vec = (vector_type *)(args->stream.a + args->stream.start_index);
+  vector_type *d_vec = (vector_type *)(args->stream.d + args->stream.start_index);
+
+  const size_t size_vec =
+      (args->stream.end_index - args->stream.start_index) / VECTOR_LEN;
+  const int fmas = args->fmas;
+  const float_type alpha = args->alpha;
+  const float_type beta = args->beta;
+
+  struct timespec start, end;
+
+  stream_barrier_wait(&start_barrier);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (fmas > 0) {
+    for (size_t i = 0; i < size_vec; i += ROOFLINE_CHAINS) {
+      vector_type x[ROOFLINE_CHAINS];
+      for (int j = 0; j < ROOFLINE_CHAINS; j++) {
+        x[j] = a_vec[i + j];
+      }
+      for (int f = 0; f < fmas; f++) {
+        for (int j = 0; j < ROOFLINE_CHAINS; j++) {
+          x[j] = x[j] * alpha + beta;
+        }
+      }
+      for (int j = 0; j < ROOFLINE_CHAINS; j++) {
+        d_vec[i + j] = x[j];
+      }
+    }
+  } else {
+    vector_type x[ROOFLINE_PEAK_CHAINS];
+    for (int j = 0; j < ROOFLINE_PEAK_CHAINS; j++) {
+      x[j] = a_vec[0] + (float_type)j;
+    }
+    for (size_t n = 0; n < ROOFLINE_PEAK_ITERATIONS; n++) {
+      for (int j = 0; j < ROOFLINE_PEAK_CHAINS; j++) {
+        x[j] = x[j] * alpha + beta;
+      }
+    }
+    for (int j = 1; j < ROOFLINE_PEAK_CHAINS; j++) {
+      x[0] += x[j];
+    }
+    args->consume = x[0][0];
+  }
+  __asm__ volatile("" ::: "memory");
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  args->stream.clock = get_time(start, end);
+
+  return NULL;
+}
+
+/**
+ * @brief Measured roofline: runs the FMA chain kernel with 1, 2, 4, ...
+ * max_fmas FMAs per element over a and d, then the compute only peak, and
+ * prints GFLOP/s and GB/s at each arithmetic intensity with the memory
+ * ceiling, the compute ceiling and the ridge point.
+ *
+ * @param vec_size
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param nr_cpu
+ * @param max_fmas
+ * @return int
+ */
+int roofline(const size_t vec_size, const int benchmark_repetitions,
+             const int warmup, const int nr_cpu, const int max_fmas) {
+
+  size_t batch_vec_size = vec_size / nr_cpu;
+  batch_vec_size -= batch_vec_size % (VECTOR_LEN * ROOFLINE_CHAINS);
+  batch_vec_size += VECTOR_LEN * ROOFLINE_CHAINS;
+  const size_t roofline_vec_size = batch_vec_size * nr_cpu;
+
+  float_type *a = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), roofline_vec_size, sizeof(float_type));
+  float_type *d = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), roofline_vec_size, sizeof(float_type));
+
+  struct roofline_args *args = calloc(nr_cpu, sizeof(struct roofline_args));
+
+  for (int i = 0; i < nr_cpu; i++) {
+    // only a and d are streamed, the initialization writes a three times
+    args[i].stream.a = a;
+    args[i].stream.b = a;
+    args[i].stream.c = a;
+    args[i].stream.d = d;
+    args[i].stream.start_index = i * batch_vec_size;
+    args[i].stream.end_index = (i + 1) * batch_vec_size;
+
+    // the chains converge to 1: no overflow and no denormals at any depth
+    args[i].alpha = 0.5;
+    args[i].beta = 0.5;
+  }
+
+  struct streams_args *th_args = calloc(nr_cpu, sizeof(struct streams_args));
+  for (int i = 0; i < nr_cpu; i++) {
+    th_args[i] = args[i].stream;
+  }
+  run_on_threads(init_thread, nr_cpu, th_args, sizeof(struct streams_args));
+  free(th_args);
+
+  // 2 flop per FMA per element, a read and d written
+  const double bytes = 2.0 * roofline_vec_size * sizeof(float_type);
+  const double peak_flop = 2.0 * VECTOR_LEN * ROOFLINE_PEAK_CHAINS *
+                           ROOFLINE_PEAK_ITERATIONS * nr_cpu;
+
+  printf("Roofline, %d threads, a and d of %.1f MiB\n", nr_cpu,
+         roofline_vec_size * sizeof(float_type) / to_MB);
+  printf("-----------------------------------------------------------\n");
+  printf("FMA/element   Intensity [flop/B]     GFLOP/s        GB/s\n");
+  printf("-----------------------------------------------------------\n");
+
+  double memory_ceiling = 0.0;
+  double compute_ceiling = 0.0;
+  float_type consume = 0.0;
+
+  // the last step (fmas == 0) is the compute only peak
+  for (int fmas = 1;; fmas = 2 * fmas <= max_fmas ? 2 * fmas : 0) {
+
+    for (int i = 0; i < nr_cpu; i++) {
+      args[i].fmas = fmas;
+    }
+
+    double average_time = 0.0;
+    for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+      run_on_threads(roofline_thread, nr_cpu, args,
+                     sizeof(struct roofline_args));
+
+      if (r >= warmup) {
+        for (int i = 0; i < nr_cpu; i++) {
+          average_time += args[i].stream.clock;
+        }
+      }
+      consume += d[r % roofline_vec_size] + args[0].consume;
+    }
+    average_time /= (double)(benchmark_repetitions * nr_cpu);
+
+    if (fmas == 0) {
+      compute_ceiling = peak_flop / average_time * 1000.0 / to_GB;
+      break;
+    }
+
+    const double flop = 2.0 * fmas * roofline_vec_size;
+    const double gflops = flop / average_time * 1000.0 / to_GB;
+    const double bandwidth_GBS = bytes / average_time * 1000.0 / to_GB;
+
+    if (bandwidth_GBS > memory_ceiling) {
+      memory_ceiling = bandwidth_GBS;
+    }
+
+    printf("%11d  %19.3f  %10.2f  %10.2f\n", fmas, flop / bytes, gflops,
+           bandwidth_GBS);
+    fflush(stdout);
+  }
+
+  printf("-----------------------------------------------------------\n");
+  printf("Memory ceiling:            %.2f GB/s\n", memory_ceiling);
+  printf("Compute ceiling:           %.2f GFLOP/s (compute only, %d chains)\n",
+         compute_ceiling, ROOFLINE_PEAK_CHAINS);
+  printf("Ridge point:               %.3f flop/B\n",
+         compute_ceiling / memory_ceiling);
+  printf("-----------------------------------------------------------\n");
+  printf("consume %f (just an output)\n\n", consume);
+
+  free(args);
+  stream_free(a);
+  stream_free(d);
+
+  return 0;
+}
+
+/* largest number of input and of output streams of the read/write mixes */
+#define RW_MAX_STREAMS 8
+
+/* vectors of a block, 4 KiB per stream: the inputs are summed in a block
+   that stays in L1 before being written to the outputs */
+#define RW_BLOCK 64
+
+struct rw_args {
+  float_type *in[RW_MAX_STREAMS];
+  float_type *out[RW_MAX_STREAMS];
+
+  int reads;
+  int writes;
+
+  size_t start_index;
+  size_t end_index;
+
+  int nt_store;
+
+  double clock;
+  float_type consume;
+};
+
+/**
+ * @brief First touch of the slice of every allocated stream.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *rw_init_thread(void *arg_void) {
+
+  struct rw_args *args = (struct rw_args *)arg_void;
+
+  for (int s = 0; s < args->reads; s++) {
+    for (size_t i = args->start_index; i < args->end_index; i++) {
+      args->in[s][i] = 1.0 + (float_type)(i % 300) / 200.0;
+    }
+  }
+  for (int s = 0; s < args->writes; s++) {
+    for (size_t i = args->start_index; i < args->end_index; i++) {
+      args->out[s][i] = 0.0;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Reads args->reads streams and writes their sum to args->writes
+ * streams. Without outputs the inputs are reduced in four accumulators
+ * (read only), without inputs the outputs are filled (write only).
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *rw_mix_thread(void *arg_void) {
+
+  struct rw_args *args = (struct rw_args *)arg_void;
+
+  vector_type *in[RW_MAX_STREAMS];
+  vector_type *out[RW_MAX_STREAMS];
+
+  for (int s = 0; s < args->reads; s++) {
+    in[s] = (vector_type *)(args->in[s] + args->start_index);
+  }
+  for (int s = 0; s < args->writes; s++) {
+    out[s] = (vector_type *)(args->out[s] + args->start_index);
+  }
+
+  const size_t size_vec = (args->end_index - args->start_index) / VECTOR_LEN;
+  const int reads = args->reads;
+  const int writes = args->writes;
+
+  vector_type acc[4] = {0};
+  vector_type block[RW_BLOCK];
+  const vector_type fill = {0};
+
+  struct timespec start, end;
+
+  stream_barrier_wait(&start_barrier);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t i = 0; i < size_vec; i += RW_BLOCK) {
+
+    if (writes == 0) {
+      for (int s = 0; s < reads; s++) {
+        for (int j = 0; j < RW_BLOCK; j += 4) {
+          acc[0] += in[s][i + j];
+          acc[1] += in[s][i + j + 1];
+          acc[2] += in[s][i + j + 2];
+          acc[3] += in[s][i + j + 3];
+        }
+      }
+      continue;
+    }
+
+    if (reads == 0) {
+      for (int j = 0; j < RW_BLOCK; j++) {
+        block[j] = fill + (float_type)i;
+      }
+    } else {
+      for (int j = 0; j < RW_BLOCK; j++) {
+        block[j] = in[0][i + j];
+      }
+      for (int s = 1; s < reads; s++) {
+        for (int j = 0; j < RW_BLOCK; j++) {
+          block[j] += in[s][i + j];
+        }
+      }
+    }
+
+    for (int s = 0; s < writes; s++) {
+      if (args->nt_store) {
+        for (int j = 0; j < RW_BLOCK; j++) {
+          stream_nt_store((float_type *)&out[s][i + j], block[j]);
+        }
+      } else {
+        for (int j = 0; j < RW_BLOCK; j++) {
+          out[s][i + j] = block[j];
+        }
+      }
+    }
+  }
+  if (args->nt_store && writes > 0) {
+    stream_nt_fence();
+  }
+  __asm__ volatile("" ::: "memory");
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  acc[0] += acc[1] + acc[2] + acc[3];
+  args->consume = acc[0][0];
+  args->clock = get_time(start, end);
+
+  return NULL;
+}
+
+/**
+ * @brief Bandwidth of each read:write mix (reads[n] input streams, writes[n]
+ * output streams), with regular and/or non-temporal stores. Every stream has
+ * vec_size elements.
+ *
+ * @param vec_size
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param nr_cpu
+ * @param store_mode
+ * @param reads
+ * @param writes
+ * @param nr_mixes
+ * @return int
+ */
+int rw_mix(const size_t vec_size, const int benchmark_repetitions,
+           const int warmup, const int nr_cpu, const int store_mode,
+           const int *reads, const int *writes, const int nr_mixes) {
+
+  size_t batch_vec_size = vec_size / nr_cpu;
+  batch_vec_size -= batch_vec_size % (VECTOR_LEN * RW_BLOCK);
+  batch_vec_size += VECTOR_LEN * RW_BLOCK;
+  const size_t rw_vec_size = batch_vec_size * nr_cpu;
+
+  int max_reads = 0;
+  int max_writes = 0;
+  for (int n = 0; n < nr_mixes; n++) {
+    max_reads = reads[n] > max_reads ? reads[n] : max_reads;
+    max_writes = writes[n] > max_writes ? writes[n] : max_writes;
+  }
+
+  struct rw_args *args = calloc(nr_cpu, sizeof(struct rw_args));
+
+  for (int s = 0; s < max_reads; s++) {
+    float_type *v = (float_type *)stream_calloc(
+        VECTOR_LEN * sizeof(float_type), rw_vec_size, sizeof(float_type));
+    for (int i = 0; i < nr_cpu; i++) {
+      args[i].in[s] = v;
+    }
+  }
+  for (int s = 0; s < max_writes; s++) {
+    float_type *v = (float_type *)stream_calloc(
+        VECTOR_LEN * sizeof(float_type), rw_vec_size, sizeof(float_type));
+    for (int i = 0; i < nr_cpu; i++) {
+      args[i].out[s] = v;
+    }
+  }
+
+  for (int i = 0; i < nr_cpu; i++) {
+    args[i].start_index = i * batch_vec_size;
+    args[i].end_index = (i + 1) * batch_vec_size;
+    args[i].reads = max_reads;
+    args[i].writes = max_writes;
+  }
+  run_on_threads(rw_init_thread, nr_cpu, args, sizeof(struct rw_args));
+
+  printf("Read/write mixes, %d threads, streams of %.1f MiB\n", nr_cpu,
+         rw_vec_size * sizeof(float_type) / to_MB);
+  printf("-----------------------------------------------------------\n");
+  printf("Mix (R:W)        Regular [GB/s]     Non-temporal [GB/s]\n");
+  printf("-----------------------------------------------------------\n");
+
+  float_type consume = 0.0;
+
+  for (int n = 0; n < nr_mixes; n++) {
+    double bandwidth[2] = {0.0, 0.0};
+
+    for (int nt = 0; nt < 2; nt++) {
+      // the store mode makes no difference without outputs
+      if (!(store_mode & (nt ? STORE_NT : STORE_REGULAR)) ||
+          (nt && writes[n] == 0)) {
+        continue;
+      }
+
+      for (int i = 0; i < nr_cpu; i++) {
+        args[i].reads = reads[n];
+        args[i].writes = writes[n];
+        args[i].nt_store = nt;
+      }
+
+      double average_time = 0.0;
+      for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+        run_on_threads(rw_mix_thread, nr_cpu, args, sizeof(struct rw_args));
+
+        if (r >= warmup) {
+          for (int i = 0; i < nr_cpu; i++) {
+            average_time += args[i].clock;
+          }
+        }
+        consume += args[0].consume;
+      }
+      average_time /= (double)(benchmark_repetitions * nr_cpu);
+
+      bandwidth[nt] =
+          compute_bandwidth(nr_cpu, reads[n] + writes[n], batch_vec_size,
+                            average_time, sizeof(float_type)) /
+          to_GB;
+    }
+
+    char mix[16];
+    snprintf(mix, sizeof(mix), "%d:%d", reads[n], writes[n]);
+    printf("%-12s", mix);
+    for (int nt = 0; nt < 2; nt++) {
+      if (bandwidth[nt] > 0.0) {
+        printf("%20.2f", bandwidth[nt]);
+      } else {
+        printf("%20s", "-");
+      }
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+
+  printf("-----------------------------------------------------------\n");
+  printf("consume %f (just an output)\n\n", consume);
+
+  for (int s = 0; s < max_reads; s++) {
+    stream_free(args[0].in[s]);
+  }
+  for (int s = 0; s < max_writes; s++) {
+    stream_free(args[0].out[s]);
+  }
+  free(args);
+
+  return 0;
+}
+
+/* most arrays walked together by the stream count sweep */
+#define STREAM_SWEEP_MAX 32
+
+struct stream_sweep_args {
+  float_type *arrays[STREAM_SWEEP_MAX];
+  int nr_arrays;
+
+  /* 0: sum all the arrays, 1: copy the first half to the second half */
+  int copy;
+
+  size_t start_index;
+  size_t end_index;
+
+  double clock;
+  float_type consume;
+};
+
+/**
+ * @brief First touch of the slice of every array.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *stream_sweep_init_thread(void *arg_void) {
+
+  struct stream_sweep_args *args = (struct stream_sweep_args *)arg_void;
+
+  for (int s = 0; s < args->nr_arrays; s++) {
+    for (size_t i = args->start_index; i < args->end_index; i++) {
+      args->arrays[s][i] = 1.0 + (float_type)(i % 300) / 200.0;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Walks all the arrays together, one vector of each array per step:
+ * the prefetchers see nr_arrays concurrent streams.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *stream_sweep_thread(void *arg_void) {
+
+  struct stream_sweep_args *args = (struct stream_sweep_args *)arg_void;
+
+  vector_type *v[STREAM_SWEEP_MAX];
+  for (int s = 0; s < args->nr_arrays; s++) {
+    v[s] = (vector_type *)(args->arrays[s] + args->start_index);
+  }
+
+  const size_t size_vec = (args->end_index - args->start_index) / VECTOR_LEN;
+  const int nr_arrays = args->nr_arrays;
+  const int half = nr_arrays / 2;
+
+  vector_type acc[4] = {0};
+
+  struct timespec start, end;
+
+  stream_barrier_wait(&start_barrier);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (args->copy) {
+    for (size_t i = 0; i < size_vec; i++) {
+      for (int s = 0; s < half; s++) {
+        v[half + s][i] = v[s][i];
+      }
+    }
+  } else {
+    for (size_t i = 0; i < size_vec; i++) {
+      // four independent chains also with a single array
+      for (int s = 0; s < nr_arrays; s++) {
+        acc[(i + s) & 3] += v[s][i];
+      }
+    }
+  }
+  __asm__ volatile("" ::: "memory");
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  acc[0] += acc[1] + acc[2] + acc[3];
+  args->consume = acc[0][0];
+  args->clock = get_time(start, end);
+
+  return NULL;
+}
+
+/**
+ * @brief Bandwidth against the number of arrays walked together, from 1 to
+ * max_arrays, at constant bytes per repetition (the size of the four vectors
+ * of the main benchmark): sum of N arrays, and copy of N / 2 arrays to N / 2
+ * others for even N. The point where the bandwidth falls is the number of
+ * streams the hardware prefetchers can track.
+ *
+ * @param vec_size
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param nr_cpu
+ * @param max_arrays
+ * @return int
+ */
+int stream_sweep(const size_t vec_size, const int benchmark_repetitions,
+                 const int warmup, const int nr_cpu, const int max_arrays) {
+
+  const size_t total_elements = 4 * vec_size;
+
+  struct stream_sweep_args *args =
+      calloc(nr_cpu, sizeof(struct stream_sweep_args));
+
+  printf("Stream count sweep, %d threads, %.1f MiB per repetition\n", nr_cpu,
+         total_elements * sizeof(float_type) / to_MB);
+  printf("-----------------------------------------------------------\n");
+  printf("Arrays      Array [MiB]        Sum [GB/s]       Copy [GB/s]\n");
+  printf("-----------------------------------------------------------\n");
+
+  double max_sum = 0.0;
+  double *sum_bandwidth = calloc(max_arrays + 1, sizeof(double));
+  float_type consume = 0.0;
+
+  for (int n = 1; n <= max_arrays; n++) {
+
+    size_t batch_vec_size = total_elements / n / nr_cpu;
+    batch_vec_size -= batch_vec_size % VECTOR_LEN;
+    if (batch_vec_size == 0) {
+      break;
+    }
+    const size_t array_size = batch_vec_size * nr_cpu;
+
+    // a cache line between the arrays avoids that they all map on the same
+    // cache sets when array_size is a large power of two
+    const size_t stride = array_size + CACHE_LINE_SIZE / sizeof(float_type);
+
+    float_type *buffer = (float_type *)stream_calloc(
+        VECTOR_LEN * sizeof(float_type), stride * n, sizeof(float_type));
+
+    for (int i = 0; i < nr_cpu; i++) {
+      for (int s = 0; s < n; s++) {
+        args[i].arrays[s] = buffer + s * stride;
+      }
+      args[i].nr_arrays = n;
+      args[i].start_index = i * batch_vec_size;
+      args[i].end_index = (i + 1) * batch_vec_size;
+    }
+    run_on_threads(stream_sweep_init_thread, nr_cpu, args,
+                   sizeof(struct stream_sweep_args));
+
+    double bandwidth[2] = {0.0, 0.0};
+
+    for (int copy = 0; copy < 2; copy++) {
+      if (copy && n % 2 != 0) {
+        continue;
+      }
+
+      for (int i = 0; i < nr_cpu; i++) {
+        args[i].copy = copy;
+      }
+
+      double average_time = 0.0;
+      for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+        run_on_threads(stream_sweep_thread, nr_cpu, args,
+                       sizeof(struct stream_sweep_args));
+
+        if (r >= warmup) {
+          for (int i = 0; i < nr_cpu; i++) {
+            average_time += args[i].clock;
+          }
+        }
+        consume += args[0].consume;
+      }
+      average_time /= (double)(benchmark_repetitions * nr_cpu);
+
+      bandwidth[copy] = compute_bandwidth(nr_cpu, n, batch_vec_size,
+                                          average_time, sizeof(float_type)) /
+                        to_GB;
+    }
+
+    sum_bandwidth[n] = bandwidth[0];
+    if (bandwidth[0] > max_sum) {
+      max_sum = bandwidth[0];
+    }
+
+    printf("%6d  %15.2f  %16.2f", n, array_size * sizeof(float_type) / to_MB,
+           bandwidth[0]);
+    if (bandwidth[1] > 0.0) {
+      printf("  %16.2f\n", bandwidth[1]);
+    } else {
+      printf("  %16s\n", "-");
+    }
+    fflush(stdout);
+
+    stream_free(buffer);
+  }
+
+  printf("-----------------------------------------------------------\n");
+
+  int peak = 1;
+  for (int n = 1; n <= max_arrays; n++) {
+    if (sum_bandwidth[n] == max_sum) {
+      peak = n;
+    }
+  }
+
+  // first count past the peak where the sum falls below 80% of it
+  int cliff = 0;
+  for (int n = peak + 1; n <= max_arrays && cliff == 0; n++) {
+    if (sum_bandwidth[n] > 0.0 && sum_bandwidth[n] < 0.8 * max_sum) {
+      cliff = n;
+    }
+  }
+
+  printf("Sum peak:                  %.2f GB/s with %d arrays\n", max_sum,
+         peak);
+  if (cliff > 0) {
+    printf("Sum below 80%% of the peak from %d arrays\n", cliff);
+  } else {
+    printf("Sum within 80%% of the peak up to %d arrays\n", max_arrays);
+  }
+  printf("consume %f (just an output)\n\n", consume);
+
+  free(sum_bandwidth);
+  free(args);
+
+  return 0;
+}
+
+/* index patterns of the gather/scatter kernel */
+#define GATHER_STRIDE 0
+#define GATHER_BLOCKED 1
+#define GATHER_RANDOM 2
+
+struct gather_args {
+  struct streams_args stream;
+
+  /* d[idx[i]] = a[idx[i]] when idx != NULL, else d[i] = a[i] every stride
+     elements */
+  unsigned int *idx;
+  size_t stride;
+
+  int init;
+};
+
+/**
+ * @brief First touch of the slice of idx (init), or strided copy, or gather
+ * from a and scatter to d through idx, over the slice of the thread.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *gather_thread(void *arg_void) {
+
+  struct gather_args *args = (struct gather_args *)arg_void;
+
+  if (args->init) {
+    for (size_t i = args->stream.start_index; i < args->stream.end_index;
+         i++) {
+      args->idx[i] = i;
+    }
+    return NULL;
+  }
+
+  float_type *a = args->stream.a;
+  float_type *d = args->stream.d;
+  const unsigned int *idx = args->idx;
+  const size_t stride = args->stride;
+  const size_t start_index = args->stream.start_index;
+  const size_t end_index = args->stream.end_index;
+
+  struct timespec start, end;
+
+  stream_barrier_wait(&start_barrier);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (idx != NULL) {
+    for (size_t i = start_index; i < end_index; i++) {
+      d[idx[i]] = a[idx[i]];
+    }
+  } else {
+    for (size_t i = start_index; i < end_index; i += stride) {
+      d[i] = a[i];
+    }
+  }
+  __asm__ volatile("" ::: "memory");
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  args->stream.clock = get_time(start, end);
+
+  return NULL;
+}
+
+/**
+ * @brief Fills idx with a permutation of 0 .. n - 1: GATHER_STRIDE visits
+ * every param-th element and then shifts by one, GATHER_BLOCKED visits blocks
+ * of param consecutive elements in random order, GATHER_RANDOM is a random
+ * permutation.
+ *
+ * @param idx
+ * @param n a multiple of param
+ * @param pattern
+ * @param param
+ */
+void make_gather_index(unsigned int *idx, const size_t n, const int pattern,
+                       const size_t param) {
+
+  const size_t unit = pattern == GATHER_BLOCKED ? param : 1;
+  const size_t nr_units = n / unit;
+
+  if (pattern == GATHER_STRIDE) {
+    const size_t per_pass = n / param;
+    for (size_t i = 0; i < n; i++) {
+      idx[i] = (i % per_pass) * param + i / per_pass;
+    }
+    return;
+  }
+
+  // Fisher-Yates over the blocks (single elements for GATHER_RANDOM)
+  size_t *order = malloc(nr_units * sizeof(size_t));
+  for (size_t i = 0; i < nr_units; i++) {
+    order[i] = i;
+  }
+
+  unsigned int seed = 1;
+  for (size_t i = nr_units - 1; i > 0; i--) {
+    // the generator has 31 bits of state, two draws cover any size
+    const unsigned int hi = seed = generate_random_number(seed);
+    const unsigned int lo = seed = generate_random_number(seed);
+    const size_t j = (((size_t)(hi >> 8) << 23) ^ (lo >> 8)) % (i + 1);
+
+    const size_t tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+
+  for (size_t i = 0; i < nr_units; i++) {
+    for (size_t k = 0; k < unit; k++) {
+      idx[i * unit + k] = order[i] * unit + k;
+    }
+  }
+
+  free(order);
+}
+
+/**
+ * @brief Least common multiple of a and b, 0 when it overflows size_t.
+ *
+ * @param a
+ * @param b
+ * @return size_t
+ */
+size_t lcm_size(const size_t a, const size_t b) {
+  size_t x = a, y = b;
+  while (y != 0) {
+    const size_t r = x % y;
+    x = y;
+    y = r;
+  }
+
+  const size_t q = a / x;
+  return q > SIZE_MAX / b ? 0 : q * b;
+}
+
+/**
+ * @brief Cache lines moved by an access sequence, counting a line each time
+ * the sequence leaves the line of the previous access: nothing is assumed to
+ * stay in cache between two visits of the same line.
+ *
+ * @param idx
+ * @param n
+ * @return size_t
+ */
+size_t count_gather_lines(const unsigned int *idx, const size_t n) {
+  const size_t per_line = CACHE_LINE_SIZE / sizeof(float_type);
+
+  size_t lines = n > 0;
+  for (size_t i = 1; i < n; i++) {
+    lines += idx[i] / per_line != idx[i - 1] / per_line;
+  }
+
+  return lines;
+}
+
+/**
+ * @brief Runs the constant stride copies (stride 1, 2, 4 ... 64 elements)
+ * and the gather/scatter through an index with a fixed stride, blocked random
+ * and random pattern. Prints the bandwidth of the useful bytes (the elements
+ * of a and d requested) and of the cache lines moved (a, d and the index).
+ *
+ * @param vec_size
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param nr_cpu
+ * @param index_stride
+ * @param block_size
+ * @return int
+ */
+int gather_benchmark(const size_t vec_size, const int benchmark_repetitions,
+                     const int warmup, const int nr_cpu,
+                     const size_t index_stride, const size_t block_size) {
+
+  // the slices must be multiples of the largest stride and of the block
+  const size_t slice_unit = lcm_size(lcm_size(64, index_stride), block_size);
+  const size_t unit = slice_unit > SIZE_MAX / nr_cpu ? 0 : slice_unit * nr_cpu;
+  if (unit == 0 || unit > vec_size) {
+    printf("Error: --gather-stride %lu and --gather-block %lu need slices of "
+           "%lu elements per thread, the vectors have %lu\n",
+           index_stride, block_size, slice_unit, vec_size / nr_cpu);
+    return 1;
+  }
+  const size_t n = (vec_size / unit + 1) * unit;
+  const size_t batch_size = n / nr_cpu;
+
+  // the index is 32 bit, as in most gather codes: it must reach every element
+  if (n > UINT32_MAX) {
+    printf("Error: --gather supports up to %u elements, the vectors have "
+           "%lu\n",
+           UINT32_MAX, n);
+    return 1;
+  }
+
+  float_type *a = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              n, sizeof(float_type));
+  float_type *d = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              n, sizeof(float_type));
+  unsigned int *idx = (unsigned int *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), n, sizeof(unsigned int));
+
+  struct gather_args *args = calloc(nr_cpu, sizeof(struct gather_args));
+
+  for (int i = 0; i < nr_cpu; i++) {
+    // only a and d are accessed, the initialization writes a three times
+    args[i].stream.a = a;
+    args[i].stream.b = a;
+    args[i].stream.c = a;
+    args[i].stream.d = d;
+    args[i].stream.start_index = i * batch_size;
+    args[i].stream.end_index = (i + 1) * batch_size;
+  }
+
+  struct streams_args *th_args = calloc(nr_cpu, sizeof(struct streams_args));
+  for (int i = 0; i < nr_cpu; i++) {
+    th_args[i] = args[i].stream;
+  }
+  run_on_threads(init_thread, nr_cpu, th_args, sizeof(struct streams_args));
+  free(th_args);
+
+  // idx is first touched in the same slices, make_gather_index fills it later
+  for (int i = 0; i < nr_cpu; i++) {
+    args[i].idx = idx;
+    args[i].init = 1;
+  }
+  run_on_threads(gather_thread, nr_cpu, args, sizeof(struct gather_args));
+  for (int i = 0; i < nr_cpu; i++) {
+    args[i].init = 0;
+  }
+
+  const size_t per_line = CACHE_LINE_SIZE / sizeof(float_type);
+
+  printf("Strided and gather/scatter access, %d threads, a and d of %.1f "
+         "MiB\n",
+         nr_cpu, n * sizeof(float_type) / to_MB);
+  printf("-----------------------------------------------------------------\n");
+  printf("Access                    Useful [GB/s]      Cache lines [GB/s]\n");
+  printf("-----------------------------------------------------------------\n");
+
+  // strides 1 .. 64, then the index patterns
+  for (int test = 0; test < 10; test++) {
+    char label[64];
+    double useful_bytes, line_bytes;
+
+    if (test < 7) {
+      const size_t stride = 1UL << test;
+      const size_t accesses = n / stride;
+
+      for (int i = 0; i < nr_cpu; i++) {
+        args[i].idx = NULL;
+        args[i].stride = stride;
+      }
+
+      snprintf(label, sizeof(label), "stride %lu", stride);
+      useful_bytes = 2.0 * accesses * sizeof(float_type);
+      line_bytes = 2.0 * CACHE_LINE_SIZE *
+                   (stride >= per_line ? accesses : n / per_line);
+    } else {
+      const int pattern = test - 7;
+      const size_t param =
+          pattern == GATHER_STRIDE ? index_stride : block_size;
+
+      make_gather_index(idx, n, pattern, param);
+
+      for (int i = 0; i < nr_cpu; i++) {
+        args[i].idx = idx;
+        args[i].stride = 1;
+      }
+
+      if (pattern == GATHER_STRIDE) {
+        snprintf(label, sizeof(label), "index stride %lu", param);
+      } else if (pattern == GATHER_BLOCKED) {
+        snprintf(label, sizeof(label), "index blocked %lu", param);
+      } else {
+        snprintf(label, sizeof(label), "index random");
+      }
+
+      useful_bytes = 2.0 * n * sizeof(float_type);
+      line_bytes = 2.0 * CACHE_LINE_SIZE * count_gather_lines(idx, n) +
+                   (double)n * sizeof(unsigned int);
+    }
+
+    double average_time = 0.0;
+    for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+      run_on_threads(gather_thread, nr_cpu, args, sizeof(struct gather_args));
+
+      if (r >= warmup) {
+        for (int i = 0; i < nr_cpu; i++) {
+          average_time += args[i].stream.clock;
+        }
+      }
+    }
+    average_time /= (double)(benchmark_repetitions * nr_cpu);
+
+    printf("%-20s  %17.2f  %22.2f\n", label,
+           useful_bytes / average_time * 1000.0 / to_GB,
+           line_bytes / average_time * 1000.0 / to_GB);
+    fflush(stdout);
+  }
+
+  printf("-----------------------------------------------------------------\n");
+  printf("consume %f (just an output)\n\n", d[n / 3]);
+
+  free(args);
+  stream_free(a);
+  stream_free(d);
+  stream_free(idx);
+
+  return 0;
+}
+
+struct gups_args {
+  uint64_t *table;
+  int table_bits;
+
+  /* slice first touched by the thread */
+  size_t start_index;
+  size_t end_index;
+
+  size_t updates;
+  int batch;
+  unsigned int seed;
+
+  int init;
+  double clock;
+};
+
+/**
+ * @brief First touch of the slice of the table (init) or timed updates.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *gups_thread(void *arg_void) {
+
+  struct gups_args *args = (struct gups_args *)arg_void;
+
+  if (args->init) {
+    for (size_t i = args->start_index; i < args->end_index; i++) {
+      args->table[i] = i;
+    }
+    return NULL;
+  }
+
+  struct timespec start, end;
+
+  stream_barrier_wait(&start_barrier);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  gups_update(args->table, args->table_bits, args->updates, args->batch,
+              args->seed);
+  __asm__ volatile("" ::: "memory");
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  args->clock = get_time(start, end);
+
+  return NULL;
+}
+
+/**
+ * @brief RandomAccess (GUPS): all the threads XOR-update random entries of a
+ * shared table, one update per entry in total at each repetition (HPCC does
+ * 4), with 1, 2, 4 ... 64 updates in flight per thread. Concurrent updates of the same entry are not
+ * synchronised, as HPCC allows.
+ *
+ * @param table_bytes
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param nr_cpu
+ * @return int
+ */
+int gups_benchmark(const size_t table_bytes, const int benchmark_repetitions,
+                   const int warmup, const int nr_cpu) {
+
+  const int table_bits = gups_table_bits(table_bytes);
+  const size_t entries = (size_t)1 << table_bits;
+
+  uint64_t *table = (uint64_t *)stream_calloc(CACHE_LINE_SIZE, entries,
+                                              sizeof(uint64_t));
+
+  struct gups_args *args = calloc(nr_cpu, sizeof(struct gups_args));
+
+  const size_t batch_size = entries / nr_cpu;
+  for (int i = 0; i < nr_cpu; i++) {
+    args[i].table = table;
+    args[i].table_bits = table_bits;
+    args[i].start_index = i * batch_size;
+    args[i].end_index = i == nr_cpu - 1 ? entries : (i + 1) * batch_size;
+    args[i].updates = entries / nr_cpu;
+    args[i].seed = i;
+    args[i].init = 1;
+  }
+  run_on_threads(gups_thread, nr_cpu, args, sizeof(struct gups_args));
+
+  printf("RandomAccess (GUPS), %d threads, table of %.1f MiB, %lu updates "
+         "per thread\n",
+         nr_cpu, entries * sizeof(uint64_t) / to_MB, args[0].updates);
+  printf("-----------------------------------------------------------\n");
+  printf("In flight          GUP/s     ns per update per thread\n");
+  printf("-----------------------------------------------------------\n");
+
+  for (int batch = 1; batch <= GUPS_MAX_BATCH; batch *= 2) {
+
+    for (int i = 0; i < nr_cpu; i++) {
+      args[i].batch = batch;
+      args[i].init = 0;
+    }
+
+    double average_time = 0.0;
+    for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+      run_on_threads(gups_thread, nr_cpu, args, sizeof(struct gups_args));
+
+      if (r >= warmup) {
+        for (int i = 0; i < nr_cpu; i++) {
+          average_time += args[i].clock;
+        }
+      }
+    }
+    average_time /= (double)(benchmark_repetitions * nr_cpu);
+
+    const double updates = (double)(args[0].updates / batch * batch);
+
+    printf("%9d  %13.4f  %27.2f\n", batch,
+           updates * nr_cpu / average_time / 1.0e6,
+           average_time * 1.0e6 / updates);
+    fflush(stdout);
+  }
+
+  printf("-----------------------------------------------------------\n");
+  printf("consume %lu (just an output)\n\n", table[entries / 3]);
+
+  free(args);
+  stream_free(table);
+
+  return 0;
+}
+
+/**
+ * @brief Time of the slowest thread in the last run of a kernel, in ms.
+ *
+ * @param th_args
+ * @param nr_cpu
+ * @return double
+ */
+double slowest_thread_clock(const struct streams_args *th_args,
+                            const int nr_cpu) {
+  double slowest = 0.0;
+  for (int i = 0; i < nr_cpu; i++) {
+    if (th_args[i].clock > slowest) {
+      slowest = th_args[i].clock;
+    }
+  }
+  return slowest;
+}
+
+/**
+ * @brief Prints which kernels run without --isa: the widest instruction set
+ * of the CPU in portable builds, else the loops compiled for the host.
+ *
+ */
+void print_default_kernels(void) {
+  if (default_isa != NULL) {
+    printf("Kernels: %s (runtime dispatch)\n\n", default_isa->name);
+  } else {
+    printf("Kernels: compiled for the build host\n\n");
+  }
+}
+
+/**
+ * @brief Runs the kernels at each thread count of the list, placing the
+ * threads with the given binding policy (compact fills a socket before the
+ * next one, scatter spreads them). Prints GB/s, the efficiency per thread
+ * relative to the smallest count and, for each kernel, the smallest thread
+ * count that reaches 95% of the peak bandwidth.
+ *
+ * @param vec_size
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param counts
+ * @param nr_counts
+ * @param bind_policy
+ * @param spawn_threads
+ * @param nt_store
+ * @return int
+ */
+int thread_sweep(const size_t vec_size, const int benchmark_repetitions,
+                 const int warmup, const int *counts, const int nr_counts,
+                 const char *bind_policy, const int spawn_threads,
+                 const int nt_store) {
+
+  // bandwidth[count][kernel] in GB/s
+  double *bandwidth = calloc(nr_counts * NR_KERNELS, sizeof(double));
+
+  int *saved_cpus = thread_cpus;
+
+  for (int n = 0; n < nr_counts; n++) {
+    const int nr_cpu = counts[n];
+
+    sweep_threads_begin(bind_policy, nr_cpu, spawn_threads);
+
+    size_t batch_vec_size = vec_size / nr_cpu;
+    batch_vec_size = (batch_vec_size - batch_vec_size % VECTOR_LEN) + VECTOR_LEN;
+    const size_t count_vec_size = batch_vec_size * nr_cpu;
+
+    // the vectors are first touched by the threads of this count
+    struct streams_args *th_args = sweep_vectors_alloc(batch_vec_size, nr_cpu);
+    for (int i = 0; i < nr_cpu; i++) {
+      th_args[i].nt_store = nt_store;
+      th_args[i].isa = default_isa;
+    }
+
+    for (int k = 0; k < NR_KERNELS; k++) {
+      struct skew_stats skew = {0};
+      double average_time = 0.0;
+
+      // the slowest thread: a count is only as fast as all its threads
+      for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+        kernels[k].benchmark(count_vec_size, nr_cpu, th_args, &skew);
+        if (r >= warmup) {
+          average_time += slowest_thread_clock(th_args, nr_cpu);
+        }
+      }
+      average_time /= (double)benchmark_repetitions;
+
+      bandwidth[n * NR_KERNELS + k] =
+          compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                            average_time, sizeof(float_type)) /
+          to_GB;
+    }
+
+    sweep_vectors_free(th_args);
+    sweep_threads_end();
+
+    printf("%d threads done\n", nr_cpu);
+    fflush(stdout);
+  }
+
+  thread_cpus = saved_cpus;
+
+  printf("\nThread scaling (%s binding%s), GB/s and efficiency per thread "
+         "relative to %d thread%s:\n",
+         bind_policy, nt_store ? ", non-temporal stores" : "", counts[0],
+         counts[0] > 1 ? "s" : "");
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n");
+  printf("Threads ");
+  for (int k = 0; k < NR_KERNELS; k++) {
+    printf("%20s", kernels[k].name);
+  }
+  printf("\n");
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n");
+
+  for (int n = 0; n < nr_counts; n++) {
+    printf("%7d ", counts[n]);
+    for (int k = 0; k < NR_KERNELS; k++) {
+      const double per_thread_base = bandwidth[k] / counts[0];
+      const double efficiency =
+          bandwidth[n * NR_KERNELS + k] / (per_thread_base * counts[n]);
+      printf("%11.2f (%4.0f%%)", bandwidth[n * NR_KERNELS + k],
+             100.0 * efficiency);
+    }
+    printf("\n");
+  }
+
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n");
+
+  printf("Peak    ");
+  for (int k = 0; k < NR_KERNELS; k++) {
+    double peak = 0.0;
+    for (int n = 0; n < nr_counts; n++) {
+      if (bandwidth[n * NR_KERNELS + k] > peak) {
+        peak = bandwidth[n * NR_KERNELS + k];
+      }
+    }
+    printf("%20.2f", peak);
+  }
+  printf("\n");
+
+  // smallest count reaching 95% of the peak of the kernel
+  printf("95%% at  ");
+  for (int k = 0; k < NR_KERNELS; k++) {
+    double peak = 0.0;
+    for (int n = 0; n < nr_counts; n++) {
+      if (bandwidth[n * NR_KERNELS + k] > peak) {
+        peak = bandwidth[n * NR_KERNELS + k];
+      }
+    }
+
+    int saturation = counts[nr_counts - 1];
+    for (int n = nr_counts - 1; n >= 0; n--) {
+      if (bandwidth[n * NR_KERNELS + k] >= 0.95 * peak &&
+          counts[n] < saturation) {
+        saturation = counts[n];
+      }
+    }
+    printf("%12d threads", saturation);
+  }
+  printf("\n");
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n\n");
+
+  free(bandwidth);
+
+  return 0;
+}
+
+#define NR_PREFETCH_DISTANCES 8
+
+/**
+ * @brief Runs the kernels with a software prefetch issued a fixed number of
+ * cache lines ahead of each stream, for no prefetch and the powers of two
+ * from 1 to 64, and for each thread count. Prints one bandwidth table per
+ * count and the best distance of each kernel with its gain over no prefetch.
+ *
+ * @param vec_size
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param counts thread counts
+ * @param nr_counts
+ * @param bind_policy
+ * @param spawn_threads
+ * @return int
+ */
+int prefetch_sweep(const size_t vec_size, const int benchmark_repetitions,
+                   const int warmup, const int *counts, const int nr_counts,
+                   const char *bind_policy, const int spawn_threads) {
+
+  const size_t distances[NR_PREFETCH_DISTANCES] = {0, 1, 2, 4, 8, 16, 32, 64};
+
+  int *saved_cpus = thread_cpus;
+
+  for (int n = 0; n < nr_counts; n++) {
+    const int nr_cpu = counts[n];
+
+    // bandwidth[distance][kernel] in GB/s
+    double bandwidth[NR_PREFETCH_DISTANCES][NR_KERNELS];
+
+    sweep_threads_begin(bind_policy, nr_cpu, spawn_threads);
+
+    size_t batch_vec_size = vec_size / nr_cpu;
+    batch_vec_size = (batch_vec_size - batch_vec_size % VECTOR_LEN) + VECTOR_LEN;
+    const size_t count_vec_size = batch_vec_size * nr_cpu;
+
+    struct streams_args *th_args = sweep_vectors_alloc(batch_vec_size, nr_cpu);
+
+    for (int p = 0; p < NR_PREFETCH_DISTANCES; p++) {
+      for (int i = 0; i < nr_cpu; i++) {
+        th_args[i].prefetch_distance = distances[p];
+      }
+
+      for (int k = 0; k < NR_KERNELS; k++) {
+        struct skew_stats skew = {0};
+        double average_time = 0.0;
+
+        for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+          const double t =
+              kernels[k].benchmark(count_vec_size, nr_cpu, th_args, &skew);
+          if (r >= warmup) {
+            average_time += t;
+          }
+        }
+        average_time /= (double)benchmark_repetitions;
+
+        bandwidth[p][k] =
+            compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                              average_time, sizeof(float_type)) /
+            to_GB;
+      }
+    }
+
+    sweep_vectors_free(th_args);
+    sweep_threads_end();
+
+    printf("\nSoftware prefetch, %d thread%s (%s binding), GB/s per prefetch "
+           "distance in cache lines:\n",
+           nr_cpu, nr_cpu > 1 ? "s" : "", bind_policy);
+    printf("-----------------------------------------------------------------"
+           "-------------------------\n");
+    printf("Distance");
+    for (int k = 0; k < NR_KERNELS; k++) {
+      printf("%20s", kernels[k].name);
+    }
+    printf("\n");
+    printf("-----------------------------------------------------------------"
+           "-------------------------\n");
+
+    for (int p = 0; p < NR_PREFETCH_DISTANCES; p++) {
+      if (distances[p] == 0) {
+        printf("    none");
+      } else {
+        printf("%8lu", distances[p]);
+      }
+      for (int k = 0; k < NR_KERNELS; k++) {
+        printf("%20.2f", bandwidth[p][k]);
+      }
+      printf("\n");
+    }
+
+    printf("-----------------------------------------------------------------"
+           "-------------------------\n");
+
+    // the best distance and its gain over the hardware prefetchers alone
+    printf("Best    ");
+    for (int k = 0; k < NR_KERNELS; k++) {
+      int best = 0;
+      for (int p = 1; p < NR_PREFETCH_DISTANCES; p++) {
+        if (bandwidth[p][k] > bandwidth[best][k]) {
+          best = p;
+        }
+      }
+      printf("%9lu (%+6.1f%%)", distances[best],
+             100.0 * (bandwidth[best][k] / bandwidth[0][k] - 1.0));
+    }
+    printf("\n");
+    printf("-----------------------------------------------------------------"
+           "-------------------------\n\n");
+    fflush(stdout);
+  }
+
+  thread_cpus = saved_cpus;
+
+  return 0;
+}
+
+const char *variant_kernel_names[VARIANT_NR_KERNELS] = {"Copy", "Axpy", "Sum"};
+const int variant_kernel_streams[VARIANT_NR_KERNELS] = {2, 3, 1};
+
+struct variant_args {
+  struct streams_args stream;
+
+  const struct variant_kernels *variant;
+  int kernel;
+
+  /* result of the reduction, kept so that it is not optimized away */
+  double sum;
+};
+
+/**
+ * @brief Runs one kernel of a shape variant inner_repetitions times over the
+ * slice of the thread.
+ *
+ * @param arg_void
+ * @return void*
+ */
+void *variant_thread(void *arg_void) {
+
+  struct variant_args *args = (struct variant_args *)arg_void;
+
+  float_type *a = args->stream.a + args->stream.start_index;
+  float_type *b = args->stream.b + args->stream.start_index;
+  float_type *d = args->stream.d + args->stream.start_index;
+  const size_t n = args->stream.end_index - args->stream.start_index;
+  const struct variant_kernels *variant = args->variant;
+
+  struct timespec start, end;
+
+  stream_barrier_wait(&start_barrier);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t r = 0; r < args->stream.inner_repetitions; r++) {
+    switch (args->kernel) {
+    case VARIANT_COPY:
+      variant->copy(d, a, n);
+      break;
+    case VARIANT_AXPY:
+      variant->axpy(d, a, b, 2.55, n);
+      break;
+    case VARIANT_SUM:
+      args->sum += variant->sum(a, n);
+      break;
+    }
+    __asm__ volatile("" ::: "memory");
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  args->stream.clock = get_time(start, end);
+
+  return NULL;
+}
+
+/**
+ * @brief
+ *
+ * @param nr_cpu
+ * @param args
+ * @return double the mean time of the threads in ms
+ */
+double variant_run(const int nr_cpu, struct variant_args *args) {
+
+  run_on_threads(variant_thread, nr_cpu, args, sizeof(struct variant_args));
+
+  double average_time = 0.0;
+  for (int i = 0; i < nr_cpu; i++) {
+    average_time += args[i].stream.clock;
+  }
+
+  return average_time / nr_cpu;
+}
+
+/**
+ * @brief Runs Copy, Axpy and Sum with each of the given shapes (vector width
+ * times unroll factor, with as many accumulators as the unroll in Sum) and
+ * prints, per kernel, a width x unroll table of GB/s and the best shape with
+ * its gain over the default shape (8x1). Small working sets repeat the
+ * kernel inside the timed region so that a sample lasts at least min_time
+ * ms, as in the cache sweep.
+ *
+ * @param vec_size
+ * @param min_time
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param nr_cpu
+ * @param variants
+ * @param nr_variants
+ * @return int
+ */
+int variant_matrix(const size_t vec_size, const double min_time,
+                   const int benchmark_repetitions, const int warmup,
+                   const int nr_cpu, const struct variant_kernels **variants,
+                   const int nr_variants) {
+
+  const size_t batch_vec_size = vec_size / nr_cpu;
+
+  float_type *a = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+  float_type *b = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+  float_type *c = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+  float_type *d = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+
+  struct variant_args *args = calloc(nr_cpu, sizeof(struct variant_args));
+
+  for (int i = 0; i < nr_cpu; i++) {
+    args[i].stream.a = a;
+    args[i].stream.b = b;
+    args[i].stream.c = c;
+    args[i].stream.d = d;
+    args[i].stream.start_index = i * batch_vec_size;
+    args[i].stream.end_index = (i + 1) * batch_vec_size;
+    args[i].stream.inner_repetitions = 1;
+  }
+
+  run_on_threads(init_thread, nr_cpu, args, sizeof(struct variant_args));
+
+  // calibration on the copy of the default shape
+  size_t inner_repetitions = 1;
+  for (;;) {
+    for (int i = 0; i < nr_cpu; i++) {
+      args[i].stream.inner_repetitions = inner_repetitions;
+      args[i].variant = variant_find(VECTOR_LEN, 1);
+      args[i].kernel = VARIANT_COPY;
+    }
+
+    const double t = variant_run(nr_cpu, args);
+    if (t >= min_time) {
+      break;
+    }
+
+    const double scale = t > 0.0 ? min_time / t : 1024.0;
+    inner_repetitions *= scale > 2.0 ? (size_t)(scale + 1.0) : 2;
+  }
+
+  // bandwidth[kernel][width][unroll] in GB/s, 0 for the shapes not run
+  double bandwidth[VARIANT_NR_KERNELS][VARIANT_NR_WIDTHS][VARIANT_NR_UNROLLS] =
+      {{{0}}};
+
+  for (int k = 0; k < VARIANT_NR_KERNELS; k++) {
+    for (int v = 0; v < nr_variants; v++) {
+      const int w = __builtin_ctz(variants[v]->width);
+      const int u = __builtin_ctz(variants[v]->unroll);
+
+      for (int i = 0; i < nr_cpu; i++) {
+        args[i].variant = variants[v];
+        args[i].kernel = k;
+      }
+
+      double average_time = 0.0;
+      for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+        const double t = variant_run(nr_cpu, args);
+        if (r >= warmup) {
+          average_time += t;
+        }
+      }
+      average_time /= (double)benchmark_repetitions;
+
+      bandwidth[k][w][u] =
+          compute_bandwidth(nr_cpu, variant_kernel_streams[k],
+                            batch_vec_size * inner_repetitions, average_time,
+                            sizeof(float_type)) /
+          to_GB;
+    }
+  }
+
+  const size_t set_bytes = 3 * vec_size * sizeof(float_type);
+  printf("Shape variants, %d threads, working set %.1f KiB, %lu inner "
+         "repetitions, GB/s:\n",
+         nr_cpu, set_bytes / 1024.0, inner_repetitions);
+
+  for (int k = 0; k < VARIANT_NR_KERNELS; k++) {
+    printf("-----------------------------------------------------------\n");
+    printf("%-10s", variant_kernel_names[k]);
+    for (int u = 0; u < VARIANT_NR_UNROLLS; u++) {
+      printf("%10s%d", "unroll ", 1 << u);
+    }
+    printf("\n");
+
+    int best_w = 0, best_u = 0;
+    for (int w = 0; w < VARIANT_NR_WIDTHS; w++) {
+      printf("width %-4d", 1 << w);
+      for (int u = 0; u < VARIANT_NR_UNROLLS; u++) {
+        if (bandwidth[k][w][u] > 0.0) {
+          printf("%11.2f", bandwidth[k][w][u]);
+        } else {
+          printf("%11s", "-");
+        }
+        if (bandwidth[k][w][u] > bandwidth[k][best_w][best_u]) {
+          best_w = w;
+          best_u = u;
+        }
+      }
+      printf("\n");
+    }
+
+    const double reference = bandwidth[k][__builtin_ctz(VECTOR_LEN)][0];
+    printf("best %dx%d: %.2f GB/s", 1 << best_w, 1 << best_u,
+           bandwidth[k][best_w][best_u]);
+    if (reference > 0.0) {
+      printf(", %+.1f%% over %dx1",
+             100.0 * (bandwidth[k][best_w][best_u] / reference - 1.0),
+             VECTOR_LEN);
+    }
+    printf("\n");
+  }
+  printf("-----------------------------------------------------------\n");
+
+  double consume = 0.0;
+  for (int i = 0; i < nr_cpu; i++) {
+    consume += args[i].sum;
+  }
+  printf("consume %f (just an output)\n\n", consume);
+
+  stream_free(a);
+  stream_free(b);
+  stream_free(c);
+  stream_free(d);
+  free(args);
+
+  return 0;
+}
+
+/**
+ * @brief Runs the kernels with each of the given instruction set flavours,
+ * regular stores, and prints the bandwidth per flavour next to the width of
+ * its loads and stores. Wide vectors can lower the bandwidth where they lower
+ * the core frequency (AVX-512 licences).
+ *
+ * @param vec_size
+ * @param benchmark_repetitions
+ * @param warmup
+ * @param nr_cpu
+ * @param isas
+ * @param nr_isas
+ * @return int
+ */
+int isa_benchmark(const size_t vec_size, const int benchmark_repetitions,
+                  const int warmup, const int nr_cpu,
+                  const struct isa_kernels **isas, const int nr_isas) {
+
+  size_t batch_vec_size = vec_size / nr_cpu;
+
+  float_type *a = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+  float_type *b = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+  float_type *c = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+  float_type *d = (float_type *)stream_calloc(
+      VECTOR_LEN * sizeof(float_type), vec_size, sizeof(float_type));
+
+  struct streams_args *th_args = calloc(nr_cpu, sizeof(struct streams_args));
+
+  for (int i = 0; i < nr_cpu; i++) {
+    th_args[i].a = a;
+    th_args[i].b = b;
+    th_args[i].c = c;
+    th_args[i].d = d;
+    th_args[i].start_index = i * batch_vec_size;
+    th_args[i].end_index = (i + 1) * batch_vec_size;
+    th_args[i].inner_repetitions = 1;
+  }
+
+  run_on_threads(init_thread, nr_cpu, th_args, sizeof(struct streams_args));
+
+  printf("Kernels per instruction set, %d threads, GB/s:\n", nr_cpu);
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n");
+  printf("ISA          Bits");
+  for (int k = 0; k < NR_KERNELS; k++) {
+    printf("%18s", kernels[k].name);
+  }
+  printf("\n");
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n");
+
+  for (int s = 0; s < nr_isas; s++) {
+    for (int i = 0; i < nr_cpu; i++) {
+      th_args[i].isa = isas[s];
+    }
+
+    if (isas[s]->vector_bits > 0) {
+      printf("%-10s %6d", isas[s]->name, isas[s]->vector_bits);
+    } else {
+      printf("%-10s %6s", isas[s]->name, "var");
+    }
+
+    for (int k = 0; k < NR_KERNELS; k++) {
+      struct skew_stats skew = {0};
+      double average_time = 0.0;
+
+      for (int r = 0; r < warmup + benchmark_repetitions; r++) {
+        const double t = kernels[k].benchmark(vec_size, nr_cpu, th_args, &skew);
+        if (r >= warmup) {
+          average_time += t;
+        }
+      }
+      average_time /= (double)benchmark_repetitions;
+
+      printf("%18.2f",
+             compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                               average_time, sizeof(float_type)) /
+                 to_GB);
+      fflush(stdout);
+    }
+    printf("\n");
+  }
+
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n\n");
+
+  stream_free(a);
+  stream_free(b);
+  stream_free(c);
+  stream_free(d);
+  free(th_args);
+
+  return 0;
+}
+
+/**
+ * @brief
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int main(const int argc, const char **argv) {
+
+  // opened first: with csv or json on stdout the report moves to stderr
+  const int output_format =
+      parse_output_format(find_command_line_arg_value(argc, argv, "--output"));
+  if (output_format < 0) {
+    printf("Error: --output must be text, csv or json\n");
+    return 1;
+  }
+
+  FILE *results_out = results_output_open(
+      output_format, find_command_line_arg_value(argc, argv, "--output-file"));
+  if (output_format != OUTPUT_TEXT && results_out == NULL) {
+    printf("Error: cannot open the --output-file\n");
+    return 1;
+  }
+
+  printf("Start My Stream [Multi Threads - Global "
+         "Memory]\n------------------------\n\n");
+
+#ifdef COMPILER
+  printf("Compiler: %s\n\n", COMPILER);
+#endif
+
+#ifdef ARCHITECTURE
+  printf("Architecture: %s\n\n", ARCHITECTURE);
+#endif
+
+  size_t vec_size = DEFAULT_TEST_SIZE;
+  int benchmark_repetitions = BENCHMARK_REPETITIONS;
+
+  if (flag_exists(argc, argv, "-h") | flag_exists(argc, argv, "--help")) {
+
+    printf("Usage: %s [options]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h, --help                  Show this help message and exit.\n");
+    printf("  -s SIZE                     Size of the vector.\n");
+    printf("  -r REPETITIONS              Number of repetitions of each "
+           "benchmark.\n");
+    printf("  --spawn                     Create and join the threads at each "
+           "repetition\n"
+           "                              instead of using a persistent "
+           "pool.\n");
+    printf(BIND_POLICY_HELP);
+    printf("                              Default: compact.\n");
+    printf(MEMBIND_HELP);
+    printf(PAGES_HELP);
+    printf(STORE_HELP);
+    printf(WARMUP_HELP);
+    printf(OUTPUT_HELP);
+    printf(PERF_HELP);
+    printf("  --threads LIST              Number of threads, default: all the "
+           "CPUs. A list of\n"
+           "                              counts (i.e. 1-8,16,32) runs the "
+           "thread scaling\n"
+           "                              sweep.\n");
+    printf("  --thread-sweep              Thread scaling sweep from 1 to all "
+           "the CPUs, with\n"
+           "                              the --bind placement (compact fills "
+           "a socket first).\n");
+    printf("  --numa-matrix               Measure the bandwidth between every "
+           "CPU node and\n"
+           "                              every memory node (CPU-less nodes "
+           "included).\n");
+    printf("  --sweep                     Run the kernels over working sets "
+           "from 4 KiB (or\n"
+           "                              --sweep-min BYTES) up to the size "
+           "given with -s,\n"
+           "                              doubling at each step, for each "
+           "--threads count.\n");
+    printf("  --min-time MS               Minimal duration of a sweep sample, "
+           "default 5 ms.\n");
+    printf("  --loaded-latency            Latency of a pointer chase on thread "
+           "0 while the\n"
+           "                              other threads stream, throttled by "
+           "each delay.\n");
+    printf("  --load-kernel KERNEL        Load of --loaded-latency: copy "
+           "(default) or axpy.\n");
+    printf("  --delays LIST               Comma separated delays [empty "
+           "iterations per chunk]\n"
+           "                              of --loaded-latency.\n");
+    printf("  --chain-size BYTES          Pointer chain of the latency probe, "
+           "default 256 MiB.\n");
+    printf("  --roofline                  Arithmetic intensity sweep: 1 to "
+           "--max-fma dependent\n"
+           "                              FMAs per element, and a compute "
+           "only peak.\n");
+    printf("  --max-fma K                 Largest FMA count of --roofline, "
+           "default 256.\n");
+    printf("  --rw-mix                    Bandwidth of read:write stream "
+           "mixes, read only\n"
+           "                              (sum) and write only (fill) "
+           "included.\n");
+    printf("  --mixes LIST                Mixes of --rw-mix as R:W pairs, R "
+           "and W in 0..8,\n"
+           "                              default "
+           "1:0,2:0,0:1,1:1,2:1,3:1,1:2,2:2,4:1,8:1.\n");
+    printf("  --stream-sweep              Sum and copy over 1 to --max-arrays "
+           "arrays walked\n"
+           "                              together, at constant bytes.\n");
+    printf("  --max-arrays N              Largest array count of "
+           "--stream-sweep, default 32.\n");
+    printf("  --gather                    Constant stride copies and "
+           "gather/scatter through\n"
+           "                              an index (stride, blocked random, "
+           "random).\n");
+    printf("  --gather-stride S           Stride of the index pattern of "
+           "--gather, default 8.\n");
+    printf("  --gather-block B            Block of the blocked random index "
+           "of --gather,\n"
+           "                              default 64 elements.\n");
+    printf(GUPS_HELP);
+    printf("  --prefetch-sweep            Kernels with a software prefetch 1, "
+           "2, 4 ... 64 cache\n"
+           "                              lines ahead (and none), for each "
+           "--threads count.\n");
+    printf(ISA_HELP);
+    printf(VARIANT_HELP);
+    printf("  --init MODE                 parallel: each thread first touches "
+           "its own slice\n"
+           "                              (default), serial: the main thread "
+           "initializes\n"
+           "                              everything (single NUMA node).\n");
+
+    printf("\n");
+    printf("Description:\n");
+    printf("  This program,  \"my_stream\" "
+           ", is designed to benchmark the memory bandwidth (in MB/s and "
+           "GB/s). \n"
+           "  In order to measure the bandwidth, it executes four "
+           "\"memory bound\" vector operations: Axpy, Copy, FMA (fused "
+           "multiply-add), and Add Mult..\n"
+           "  Visit: https://github.com/simon-r/My_Stream_Benchmark \n");
+
+    printf("\n");
+    return 0;
+  }
+
+  const char *vec_size_arg = find_command_line_arg_value(argc, argv, "-s");
+
+  if (vec_size_arg != NULL) {
+
+    if (is_number(vec_size_arg)) {
+      vec_size = strtoul(vec_size_arg, NULL, 10);
+      printf("User defined vector size: %lu\n", vec_size);
+    } else {
+      printf("Error: argument of -s is not numeric\n");
+      return 1;
+    }
+  }
+
+  const char *benchmark_repetitions_arg =
+      find_command_line_arg_value(argc, argv, "-r");
+
+  if (benchmark_repetitions_arg != NULL) {
+    if (is_number(benchmark_repetitions_arg)) {
+      benchmark_repetitions = atoi(benchmark_repetitions_arg);
+      printf("User defined benchmark repetitions: %d\n", benchmark_repetitions);
+    } else {
+      printf("Error: argv -r is not numeric\n");
+      return 1;
+    }
+  }
+
+  const char *mem_node_arg = find_command_line_arg_value(argc, argv, "--membind");
+
+  if (mem_node_arg != NULL) {
+    if (is_number(mem_node_arg)) {
+      mem_node = atoi(mem_node_arg);
+      printf("User defined NUMA node of the vectors: %d\n", mem_node);
+    } else {
+      printf("Error: argument of --membind is not numeric\n");
+      return 1;
+    }
+  }
+
+  int warmup = DEFAULT_WARMUP;
+  const char *warmup_arg = find_command_line_arg_value(argc, argv, "--warmup");
+  if (warmup_arg != NULL) {
+    if (!is_number(warmup_arg)) {
+      printf("Error: argument of --warmup is not numeric\n");
+      return 1;
+    }
+    warmup = atoi(warmup_arg);
+  }
+
+  page_mode =
+      parse_page_mode(find_command_line_arg_value(argc, argv, "--pages"));
+  if (page_mode < 0) {
+    printf("Error: --pages must be 4k, thp, 2m or 1g\n");
+    return 1;
+  }
+
+  const int spawn_threads = flag_exists(argc, argv, "--spawn");
+
+  const int store_mode =
+      parse_store_mode(find_command_line_arg_value(argc, argv, "--store"));
+  if (store_mode == 0) {
+    printf("Error: --store must be regular, nt or both\n");
+    return 1;
+  }
+
+  const char *init_arg = find_command_line_arg_value(argc, argv, "--init");
+  if (init_arg != NULL && strcmp(init_arg, "serial") != 0 &&
+      strcmp(init_arg, "parallel") != 0) {
+    printf("Error: --init must be serial or parallel\n");
+    return 1;
+  }
+  const int serial_init = init_arg != NULL && strcmp(init_arg, "serial") == 0;
+
+  int max_fmas = 256;
+  const char *max_fma_arg = find_command_line_arg_value(argc, argv, "--max-fma");
+  if (max_fma_arg != NULL) {
+    if (!is_number(max_fma_arg) || atoi(max_fma_arg) < 1) {
+      printf("Error: argument of --max-fma must be a positive number\n");
+      return 1;
+    }
+    max_fmas = atoi(max_fma_arg);
+  }
+
+  size_t sweep_min_bytes = 4096;
+  const char *sweep_min_arg =
+      find_command_line_arg_value(argc, argv, "--sweep-min");
+  if (sweep_min_arg != NULL) {
+    if (!is_number(sweep_min_arg)) {
+      printf("Error: argument of --sweep-min is not numeric\n");
+      return 1;
+    }
+    sweep_min_bytes = strtoul(sweep_min_arg, NULL, 10);
+  }
+
+  double sweep_min_time = 5.0;
+  const char *min_time_arg = find_command_line_arg_value(argc, argv, "--min-time");
+  if (min_time_arg != NULL) {
+    if (!is_number(min_time_arg)) {
+      printf("Error: argument of --min-time is not numeric\n");
+      return 1;
+    }
+    sweep_min_time = atof(min_time_arg);
+  }
+
+  const char *load_kernel_arg =
+      find_command_line_arg_value(argc, argv, "--load-kernel");
+  if (load_kernel_arg != NULL && strcmp(load_kernel_arg, "copy") != 0 &&
+      strcmp(load_kernel_arg, "axpy") != 0) {
+    printf("Error: --load-kernel must be copy or axpy\n");
+    return 1;
+  }
+  const int load_role = load_kernel_arg != NULL &&
+                                strcmp(load_kernel_arg, "axpy") == 0
+                            ? LOADED_AXPY
+                            : LOADED_COPY;
+
+  size_t chain_bytes = 256UL * 1024 * 1024;
+  const char *chain_size_arg =
+      find_command_line_arg_value(argc, argv, "--chain-size");
+  if (chain_size_arg != NULL) {
+    if (!is_number(chain_size_arg)) {
+      printf("Error: argument of --chain-size is not numeric\n");
+      return 1;
+    }
+    chain_bytes = strtoul(chain_size_arg, NULL, 10);
+  }
+  if (chain_bytes < 2 * CACHE_LINE_SIZE) {
+    printf("Error: --chain-size must be at least %d bytes\n",
+           2 * CACHE_LINE_SIZE);
+    return 1;
+  }
+
+  // from the lightest to the heaviest load
+  size_t delays[64] = {100000, 50000, 20000, 10000, 5000, 2000, 1000,
+                       500,    200,   100,   50,    20,   0};
+  int nr_delays = 13;
+
+  const char *delays_arg = find_command_line_arg_value(argc, argv, "--delays");
+  if (delays_arg != NULL) {
+    nr_delays = 0;
+    const char *p = delays_arg;
+
+    while (*p != '\0' && nr_delays < 64) {
+      char *next;
+      delays[nr_delays++] = strtoul(p, &next, 10);
+
+      if (next == p || (*next != ',' && *next != '\0')) {
+        printf("Error: --delays must be a comma separated list of numbers\n");
+        return 1;
+      }
+      p = *next == ',' ? next + 1 : next;
+    }
+  }
+
+  size_t gups_bytes = 4 * vec_size * sizeof(float_type);
+  const char *gups_size_arg =
+      find_command_line_arg_value(argc, argv, "--gups-size");
+  if (gups_size_arg != NULL) {
+    if (!is_number(gups_size_arg)) {
+      printf("Error: argument of --gups-size is not numeric\n");
+      return 1;
+    }
+    gups_bytes = strtoul(gups_size_arg, NULL, 10);
+  }
+
+  size_t gather_stride = 8;
+  const char *gather_stride_arg =
+      find_command_line_arg_value(argc, argv, "--gather-stride");
+  if (gather_stride_arg != NULL) {
+    if (!is_number(gather_stride_arg) || atoi(gather_stride_arg) < 1) {
+      printf("Error: argument of --gather-stride must be a positive number\n");
+      return 1;
+    }
+    gather_stride = strtoul(gather_stride_arg, NULL, 10);
+  }
+
+  size_t gather_block = 64;
+  const char *gather_block_arg =
+      find_command_line_arg_value(argc, argv, "--gather-block");
+  if (gather_block_arg != NULL) {
+    if (!is_number(gather_block_arg) || atoi(gather_block_arg) < 1) {
+      printf("Error: argument of --gather-block must be a positive number\n");
+      return 1;
+    }
+    gather_block = strtoul(gather_block_arg, NULL, 10);
+  }
+
+  int max_arrays = STREAM_SWEEP_MAX;
+  const char *max_arrays_arg =
+      find_command_line_arg_value(argc, argv, "--max-arrays");
+  if (max_arrays_arg != NULL) {
+    if (!is_number(max_arrays_arg) || atoi(max_arrays_arg) < 1 ||
+        atoi(max_arrays_arg) > STREAM_SWEEP_MAX) {
+      printf("Error: argument of --max-arrays must be between 1 and %d\n",
+             STREAM_SWEEP_MAX);
+      return 1;
+    }
+    max_arrays = atoi(max_arrays_arg);
+  }
+
+  int mix_reads[64] = {1, 2, 0, 1, 2, 3, 1, 2, 4, 8};
+  int mix_writes[64] = {0, 0, 1, 1, 1, 1, 2, 2, 1, 1};
+  int nr_mixes = 10;
+
+  const char *mixes_arg = find_command_line_arg_value(argc, argv, "--mixes");
+  if (mixes_arg != NULL) {
+    nr_mixes = 0;
+    const char *p = mixes_arg;
+
+    while (*p != '\0' && nr_mixes < 64) {
+      int reads, writes, len;
+      if (sscanf(p, "%d:%d%n", &reads, &writes, &len) != 2 || reads < 0 ||
+          writes < 0 || reads > RW_MAX_STREAMS || writes > RW_MAX_STREAMS ||
+          reads + writes == 0 || (p[len] != ',' && p[len] != '\0')) {
+        printf("Error: --mixes must be a comma separated list of R:W, R and "
+               "W in 0..%d\n",
+               RW_MAX_STREAMS);
+        return 1;
+      }
+      mix_reads[nr_mixes] = reads;
+      mix_writes[nr_mixes] = writes;
+      nr_mixes++;
+
+      p += p[len] == ',' ? len + 1 : len;
+    }
+  }
+
+  const struct isa_kernels *isas[nr_isa];
+  int nr_isas = 0;
+
+  const char *isa_arg = find_command_line_arg_value(argc, argv, "--isa");
+  if (isa_arg != NULL) {
+    if (strcmp(isa_arg, "all") == 0) {
+      for (int i = 0; i < nr_isa; i++) {
+        if (isa_table[i].supported()) {
+          isas[nr_isas++] = &isa_table[i];
+        }
+      }
+    } else {
+      const struct isa_kernels *isa = isa_find(isa_arg);
+      if (isa == NULL) {
+        printf("Error: unknown --isa %s\n", isa_arg);
+        print_isa_list();
+        return 1;
+      }
+      if (!isa->supported()) {
+        printf("Error: the CPU does not support %s\n", isa->name);
+        return 1;
+      }
+      isas[nr_isas++] = isa;
+    }
+  }
+
+#ifdef PORTABLE_BUILD
+  // the compiled loops only use the baseline of the architecture
+  if (isa_arg == NULL) {
+    default_isa = isa_find("auto");
+  }
+#endif
+
+  const struct variant_kernels
+      *variants[VARIANT_NR_WIDTHS * VARIANT_NR_UNROLLS];
+  int nr_variants = 0;
+
+  const char *variant_arg = find_command_line_arg_value(argc, argv, "--variant");
+  if (variant_arg != NULL) {
+    int width, unroll, len;
+    if (sscanf(variant_arg, "%dx%d%n", &width, &unroll, &len) != 2 ||
+        variant_arg[len] != '\0' ||
+        (variants[0] = variant_find(width, unroll)) == NULL) {
+      printf("Error: --variant must be WxU, W in 1,2,4,8,16 and U in "
+             "1,2,4,8\n");
+      return 1;
+    }
+    nr_variants = 1;
+  } else if (flag_exists(argc, argv, "--variant-matrix")) {
+    for (int i = 0; i < VARIANT_NR_WIDTHS * VARIANT_NR_UNROLLS; i++) {
+      variants[nr_variants++] = &variant_table[i];
+    }
+  }
+
+  // get the number of cpu from open mp
+  int nr_cpu = omp_get_num_procs();
+
+  int *thread_counts = NULL;
+  int nr_thread_counts = 0;
+
+  const char *threads_arg = find_command_line_arg_value(argc, argv, "--threads");
+  if (threads_arg != NULL) {
+    nr_thread_counts = parse_thread_list(threads_arg, &thread_counts);
+    if (nr_thread_counts == 0) {
+      printf("Error: --threads must be a thread count or a list such as "
+             "1-4,8\n");
+      return 1;
+    }
+  } else if (flag_exists(argc, argv, "--thread-sweep")) {
+    nr_thread_counts = nr_cpu;
+    thread_counts = malloc(nr_cpu * sizeof(int));
+    for (int i = 0; i < nr_cpu; i++) {
+      thread_counts[i] = i + 1;
+    }
+  }
+
+  // a single count replaces the number of CPUs, a list runs the sweep
+  if (nr_thread_counts == 1) {
+    nr_cpu = thread_counts[0];
+  }
+
+  // the first nr_list_modes modes run each count of a --threads list
+  const char *mode_flags[] = {"--thread-sweep",   "--prefetch-sweep",
+                              "--sweep",          "--numa-matrix",
+                              "--loaded-latency", "--gups",
+                              "--gather",         "--stream-sweep",
+                              "--rw-mix",         "--roofline"};
+  const int nr_mode_flags = sizeof(mode_flags) / sizeof(mode_flags[0]);
+  const int nr_list_modes = 3;
+
+  int mode = nr_thread_counts > 1 || nr_isas > 0 || nr_variants > 0;
+  int single_count_mode = nr_isas > 0 || nr_variants > 0;
+  for (int i = 0; i < nr_mode_flags; i++) {
+    const int set = flag_exists(argc, argv, mode_flags[i]);
+    mode |= set;
+    single_count_mode |= set && i >= nr_list_modes;
+  }
+
+  if (nr_thread_counts > 1 && single_count_mode) {
+    printf("Error: a list of thread counts runs with --sweep, "
+           "--prefetch-sweep or alone, the other modes take a single "
+           "count\n");
+    free(thread_counts);
+    return 1;
+  }
+
+  // the records of --output describe the default kernels only
+  if (output_format != OUTPUT_TEXT && mode) {
+    printf("Error: --output csv|json reports the default kernels, it cannot "
+           "be combined with a mode such as --gups, --sweep or --isa\n");
+    return 1;
+  }
+
+  // oversubscribed threads would time slice and look like perfect scaling
+  const int max_threads = nr_allowed_cpus();
+  for (int i = 0; i < nr_thread_counts; i++) {
+    if (thread_counts[i] > max_threads) {
+      printf("Error: --threads %d exceeds the %d CPUs the process may run "
+             "on\n",
+             thread_counts[i], max_threads);
+      free(thread_counts);
+      return 1;
+    }
+  }
+
+  const char *bind_policy = find_command_line_arg_value(argc, argv, "--bind");
+  if (bind_policy == NULL) {
+    bind_policy = "compact";
+  }
+
+  // a list is checked against its largest count, the sweeps bind each count
+  int bind_threads = nr_cpu;
+  if (nr_thread_counts > 1) {
+    bind_threads = 0;
+    for (int i = 0; i < nr_thread_counts; i++) {
+      bind_threads =
+          thread_counts[i] > bind_threads ? thread_counts[i] : bind_threads;
+    }
+  }
+
+  // the load threads of --loaded-latency keep off the core of the probe
+  thread_cpus = flag_exists(argc, argv, "--loaded-latency")
+                    ? make_probe_cpu_binding(bind_policy, bind_threads)
+                    : make_cpu_binding(bind_policy, bind_threads);
+  if (thread_cpus == NULL) {
+    printf("Error: invalid --bind policy %s, a CPU not allowed or fewer "
+           "CPUs than the %d threads\n",
+           bind_policy, bind_threads);
+    free(thread_counts);
+    return 1;
+  }
+  vec_size = vec_size / nr_cpu;
+  vec_size = ((vec_size - vec_size % VECTOR_LEN) + VECTOR_LEN) * nr_cpu;
+
+  // double to_MB = (1024.0 * 1024.0);
+  // double to_GB = (1024.0 * 1024.0 * 1024.0);
+
+  double bytes_vec_size = (double)(vec_size * sizeof(float_type));
+  double MB_vec_size = bytes_vec_size / to_MB;
+  double GB_vec_size = bytes_vec_size / to_GB;
+
+  printf("\n-----------------------------------------------------------\n");
+  printf("Number of CPU:             %d\n", nr_cpu);
+  printf("Adjusted vector size:      %lu\n", vec_size);
+  printf("MB Vector size:            %f\n", MB_vec_size);
+  printf("GB Vector size:            %f\n", GB_vec_size);
+  printf("GB Total allocated memory: %f\n", GB_vec_size * 4);
+  printf("Repetitions:               %d\n", benchmark_repetitions);
+  printf("Threads:                   %s\n",
+         spawn_threads ? "spawned at each repetition" : "persistent pool");
+  print_cpu_binding(bind_policy, thread_cpus, nr_cpu);
+  print_isa_list();
+  printf("-----------------------------------------------------------\n\n");
+
+  if (flag_exists(argc, argv, "--prefetch-sweep")) {
+    const int err = prefetch_sweep(
+        vec_size, benchmark_repetitions, warmup,
+        nr_thread_counts > 0 ? thread_counts : &nr_cpu,
+        nr_thread_counts > 0 ? nr_thread_counts : 1, bind_policy, spawn_threads);
+    free(thread_counts);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (flag_exists(argc, argv, "--sweep")) {
+    // one table per thread count of --threads
+    const int *counts = nr_thread_counts > 0 ? thread_counts : &nr_cpu;
+    const int nr_counts = nr_thread_counts > 0 ? nr_thread_counts : 1;
+
+    int max_count = 0;
+    for (int n = 0; n < nr_counts; n++) {
+      max_count = counts[n] > max_count ? counts[n] : max_count;
+    }
+
+    // each thread needs a cache line of each vector, and the size doubles
+    if (sweep_min_bytes < 4 * CACHE_LINE_SIZE * (size_t)max_count) {
+      printf("Error: --sweep-min must be at least %lu bytes with %d threads\n",
+             4 * CACHE_LINE_SIZE * (size_t)max_count, max_count);
+      free(thread_counts);
+      free(thread_cpus);
+      return 1;
+    }
+
+    int *saved_cpus = thread_cpus;
+    int err = 0;
+    for (int n = 0; n < nr_counts && err == 0; n++) {
+      sweep_threads_begin(bind_policy, counts[n], spawn_threads);
+      err = cache_sweep(vec_size, sweep_min_bytes, sweep_min_time,
+                        benchmark_repetitions, counts[n],
+                        store_mode == STORE_NT);
+      sweep_threads_end();
+    }
+    thread_cpus = saved_cpus;
+
+    free(thread_counts);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (nr_thread_counts > 1 || flag_exists(argc, argv, "--thread-sweep")) {
+    print_default_kernels();
+    const int err = thread_sweep(vec_size, benchmark_repetitions, warmup,
+                                 thread_counts, nr_thread_counts, bind_policy,
+                                 spawn_threads, store_mode == STORE_NT);
+    free(thread_counts);
+    free(thread_cpus);
+    return err;
+  }
+  free(thread_counts);
+
+  if (flag_exists(argc, argv, "--numa-matrix")) {
+    const int err =
+        numa_matrix(vec_size, benchmark_repetitions, spawn_threads);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (!spawn_threads) {
+    pool = stream_pool_create(nr_cpu, thread_cpus);
+
+    if (pool == NULL) {
+      printf("Error: cannot create the thread pool\n");
+      return 1;
+    }
+  }
+
+  stream_barrier_init(&start_barrier, nr_cpu);
+
+  if (flag_exists(argc, argv, "--loaded-latency")) {
+    const int err = loaded_latency(vec_size, chain_bytes, nr_cpu, load_role,
+                                   delays, nr_delays);
+    stream_pool_destroy(pool);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (flag_exists(argc, argv, "--gups")) {
+    const int err = gups_benchmark(gups_bytes, benchmark_repetitions, warmup,
+                                   nr_cpu);
+    stream_pool_destroy(pool);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (flag_exists(argc, argv, "--gather")) {
+    const int err = gather_benchmark(vec_size, benchmark_repetitions, warmup,
+                                     nr_cpu, gather_stride, gather_block);
+    stream_pool_destroy(pool);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (flag_exists(argc, argv, "--stream-sweep")) {
+    const int err = stream_sweep(vec_size, benchmark_repetitions, warmup,
+                                 nr_cpu, max_arrays);
+    stream_pool_destroy(pool);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (flag_exists(argc, argv, "--rw-mix")) {
+    const int err = rw_mix(vec_size, benchmark_repetitions, warmup, nr_cpu,
+                           store_mode, mix_reads, mix_writes, nr_mixes);
+    stream_pool_destroy(pool);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (nr_variants > 0) {
+    const int err =
+        variant_matrix(vec_size, sweep_min_time, benchmark_repetitions, warmup,
+                       nr_cpu, variants, nr_variants);
+    stream_pool_destroy(pool);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (nr_isas > 0) {
+    const int err = isa_benchmark(vec_size, benchmark_repetitions, warmup,
+                                  nr_cpu, isas, nr_isas);
+    stream_pool_destroy(pool);
+    free(thread_cpus);
+    return err;
+  }
+
+  if (flag_exists(argc, argv, "--roofline")) {
+    const int err = roofline(vec_size, benchmark_repetitions, warmup, nr_cpu,
+                             max_fmas);
+    stream_pool_destroy(pool);
+    free(thread_cpus);
+    return err;
+  }
+
+  // malloc a aligned to 4 * sizeof(float_type)
+  float_type *a = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              vec_size, sizeof(float_type));
+  float_type *b = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              vec_size, sizeof(float_type));
+  float_type *c = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              vec_size, sizeof(float_type));
+  float_type *d = (float_type *)stream_calloc(VECTOR_LEN * sizeof(float_type),
+                                              vec_size, sizeof(float_type));
+
+  struct streams_args *th_args = calloc(nr_cpu, sizeof(struct streams_args));
+
+  size_t batch_vec_size = vec_size / nr_cpu;
+
+  for (int i = 0; i < nr_cpu; i++) {
+    th_args[i].a = a;
+    th_args[i].b = b;
+    th_args[i].c = c;
+    th_args[i].d = d;
+    th_args[i].start_index = i * batch_vec_size;
+    th_args[i].end_index = (i + 1) * batch_vec_size;
+    th_args[i].nt_store = 0;
+    th_args[i].isa = default_isa;
+    th_args[i].inner_repetitions = 1;
+  }
+
+  struct timespec init_start, init_end;
+  clock_gettime(CLOCK_MONOTONIC, &init_start);
+
+  if (serial_init) {
+    // all the pages are first touched by the main thread
+    unsigned int r = 1;
+    for (size_t i = 0; i < vec_size; i++) {
+      r = generate_random_number(r);
+      a[i] = 1.0 + (float_type)(r % 300) / 200.0;
+      b[i] = 1.0 + (float_type)(r % 400) / 300.0;
+      c[i] = 1.0 + (float_type)(r % 500) / 300.0;
+      d[i] = 0.0;
+    }
+  } else {
+    run_on_threads(init_thread, nr_cpu, th_args,
+                   sizeof(struct streams_args));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &init_end);
+
+  printf("Initialization (%s):    %.3f ms\n",
+         serial_init ? "serial" : "parallel", get_time(init_start, init_end));
+
+  // read back after the first touch, THP and hugetlbfs may have fallen back
+  char pages[32];
+  describe_pages(a, pages, sizeof(pages));
+  printf("Pages (%s requested):  %s\n\n", page_mode_name(page_mode), pages);
+  print_default_kernels();
+
+  const int use_perf = flag_exists(argc, argv, "--perf") && perf_init(1);
+  if (use_perf) {
+    printf("IMC counters: %d\n\n", perf_imc_open());
+  }
+
+  // [kernel][0: regular stores, 1: non-temporal stores]
+  double average_time[NR_KERNELS][2] = {{0.0}};
+  struct skew_stats skew[NR_KERNELS][2] = {{{0}}};
+  struct stream_samples *samples[NR_KERNELS][2] = {{NULL}};
+  struct perf_values perf[NR_KERNELS][2] = {{{{0}}}};
+
+  double consume = 0.0;
+
+  for (int k = 0; k < NR_KERNELS; k++) {
+    for (int nt = 0; nt < 2; nt++) {
+
+      if (!(store_mode & (nt ? STORE_NT : STORE_REGULAR))) {
+        continue;
+      }
+
+      for (int i = 0; i < nr_cpu; i++) {
+        th_args[i].nt_store = nt;
+      }
+
+      samples[k][nt] = stream_samples_create(
+          nr_cpu, warmup + benchmark_repetitions, warmup);
+
+      for (int i = 0; i < warmup + benchmark_repetitions; i++) {
+        struct skew_stats warmup_skew = {0};
+        struct perf_values rep_perf = {{0}};
+
+        for (int j = 0; j < nr_cpu; j++) {
+          memset(&th_args[j].perf, 0, sizeof(struct perf_values));
+        }
+
+        if (use_perf) {
+          perf_imc_start();
+        }
+        const double t = kernels[k].benchmark(
+            vec_size, nr_cpu, th_args,
+            i < warmup ? &warmup_skew : &skew[k][nt]);
+        if (use_perf) {
+          perf_imc_stop(&rep_perf);
+        }
+
+        if (i >= warmup) {
+          average_time[k][nt] += t;
+
+          for (int j = 0; j < nr_cpu; j++) {
+            perf_values_add(&rep_perf, &th_args[j].perf);
+          }
+          perf_values_add(&perf[k][nt], &rep_perf);
+        }
+        for (int j = 0; j < nr_cpu; j++) {
+          stream_samples_set(samples[k][nt], j, i, th_args[j].clock);
+        }
+        consume += a[100] + b[1002] + c[1002] + d[1002];
+      }
+
+      average_time[k][nt] /= (double)(benchmark_repetitions);
+    }
+  }
+
+  // the main tables refer to the regular stores, unless only nt is selected
+  const int main_nt = store_mode == STORE_NT;
+
+#define SEP                                                                    \
+  "--------------------------------------------------------------------------" \
+  "---------------------"                                                      \
+  "\n\n"
+
+  printf(SEP);
+
+  printf("consume %f (just an output)\n", consume);
+
+  printf(SEP);
+
+  printf("Results%s:\n", main_nt ? " (non-temporal stores)" : "");
+  printf(SEP);
+  printf("Benchmark:            GB/s                 Memory Streamed [MB]      "
+         "Avg. Clock [ms]\n");
+  printf(SEP);
+
+  for (int k = 0; k < NR_KERNELS; k++) {
+    const double memory_streamed_MB = (double)kernels[k].nr_streams *
+                                      batch_vec_size * nr_cpu *
+                                      sizeof(float_type) / to_MB *
+                                      benchmark_repetitions;
+
+    const double bandwidth_GBS =
+        compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                          average_time[k][main_nt], sizeof(float_type)) /
+        to_GB;
+
+    char label[32];
+    snprintf(label, sizeof(label), "%s:", kernels[k].name);
+
+    printf("%-10s  %15.2lf [GB/s]         %lf                 %lf\n", label,
+           bandwidth_GBS, memory_streamed_MB, average_time[k][main_nt]);
+  }
+
+  printf(SEP);
+
+  if (store_mode == STORE_BOTH) {
+    printf("Regular vs non-temporal stores:\n");
+    printf(SEP);
+    printf("Benchmark:     Regular [GB/s]    Non-temporal [GB/s]     "
+           "NT / Regular\n");
+    printf(SEP);
+
+    for (int k = 0; k < NR_KERNELS; k++) {
+      const double regular_GBS =
+          compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                            average_time[k][0], sizeof(float_type)) /
+          to_GB;
+      const double nt_GBS =
+          compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                            average_time[k][1], sizeof(float_type)) /
+          to_GB;
+
+      char label[32];
+      snprintf(label, sizeof(label), "%s:", kernels[k].name);
+
+      printf("%-10s  %15.2lf  %20.2lf  %15.3lf\n", label, regular_GBS, nt_GBS,
+             nt_GBS / regular_GBS);
+    }
+
+    printf(SEP);
+  }
+
+  print_sample_stats_header(warmup);
+
+  struct results_data results[2 * NR_KERNELS];
+  int nr_results = 0;
+
+  for (int k = 0; k < NR_KERNELS; k++) {
+    for (int nt = 0; nt < 2; nt++) {
+      if (samples[k][nt] == NULL) {
+        continue;
+      }
+
+      struct sample_stats stats;
+      stream_samples_stats(samples[k][nt], &stats);
+
+      char label[32];
+      snprintf(label, sizeof(label), "%s%s:", kernels[k].name,
+               nt ? " nt" : "");
+
+      const double bytes =
+          (double)kernels[k].nr_streams * vec_size * sizeof(float_type);
+
+      print_sample_stats(label, &stats, bytes);
+      make_results_data(&results[nr_results++], kernels[k].id, nt, &stats,
+                        bytes);
+    }
+  }
+
+  printf(SEP);
+
+  if (use_perf) {
+    print_perf_header();
+
+    for (int k = 0; k < NR_KERNELS; k++) {
+      for (int nt = 0; nt < 2; nt++) {
+        if (samples[k][nt] == NULL) {
+          continue;
+        }
+
+        char label[32];
+        snprintf(label, sizeof(label), "%s%s:", kernels[k].name,
+                 nt ? " nt" : "");
+
+        const double bytes = (double)kernels[k].nr_streams * vec_size *
+                             sizeof(float_type) * benchmark_repetitions;
+        const double bandwidth_GBS =
+            compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                              average_time[k][nt], sizeof(float_type)) /
+            to_GB;
+
+        print_perf_row(label, &perf[k][nt], bytes, bandwidth_GBS);
+      }
+    }
+
+    printf(SEP);
+    perf_imc_close();
+  }
+
+  printf("Threads skew (spread of the start and end clocks among threads):\n");
+  printf(SEP);
+  printf("Benchmark:     Start mean [ms]   Start max [ms]     End mean [ms]     "
+         "End max [ms]\n");
+  printf(SEP);
+
+  for (int k = 0; k < NR_KERNELS; k++) {
+    const struct skew_stats *sk = &skew[k][main_nt];
+
+    char label[32];
+    snprintf(label, sizeof(label), "%s:", kernels[k].name);
+
+    printf("%-10s  %15.4lf  %15.4lf   %15.4lf  %15.4lf\n", label,
+           skew_stats_start_mean(sk), sk->start_max, skew_stats_end_mean(sk),
+           sk->end_max);
+  }
+
+  printf(SEP);
+
+  const struct results_info info = {.benchmark = "mt_gm",
+                                    .nr_threads = nr_cpu,
+                                    .nr_ranks = 1,
+                                    .binding = bind_policy,
+                                    .pages = pages,
+                                    .vec_size = vec_size,
+                                    .element_size = sizeof(float_type),
+                                    .repetitions = benchmark_repetitions,
+                                    .warmup = warmup};
+
+  if (results_output_write(results_out, output_format, &info, results,
+                           nr_results)) {
+    printf("Error: cannot write the results\n");
+  }
+
+  stream_free(a);
+  stream_free(b);
+  stream_free(c);
+  stream_free(d);
+  free(th_args);
+
+  for (int k = 0; k < NR_KERNELS; k++) {
+    stream_samples_free(samples[k][0]);
+    stream_samples_free(samples[k][1]);
+  }
+
+  stream_pool_destroy(pool);
+  free(thread_cpus);
 
   return 0;
 }
@@ -29,12 +29,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <omp.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include "my_stream_nt.h"
+#include "my_stream_perf.h"
 #include "my_stream_utils.h"
 
 #define DEFAULT_TEST_SIZE 50000000
@@ -61,15 +62,38 @@ struct streams_args {
   double consume_out;
   size_t benchmark_repetitions;
 
-  sem_t *semaphore;
+  int nt_store;
+
+  /* pages backing the vectors of the thread, read after the first touch */
+  char pages[32];
+
+  struct stream_barrier *barrier;
+  struct timespec *start_stamps;
+  struct timespec *end_stamps;
+
+  /* with --perf: counters of the measured repetitions */
+  int thread_id;
+  size_t warmup;
+  struct perf_values perf;
 };
 
+/* CPU of each thread, -1 when the thread is not pinned */
+int *thread_cpus = NULL;
+
 struct benchmark_results {
   double total_bandwidth;
   double mean_clock;
   double consume;
+  struct skew_stats skew;
+  struct sample_stats stats;
 };
 
+/* NUMA node of the vectors, -1 for the default allocation */
+int mem_node = -1;
+
+/* pages backing the vectors, one of PAGES_* */
+int page_mode = PAGES_DEFAULT;
+
 /**
  * @brief
  *
@@ -79,9 +103,25 @@ struct benchmark_results {
  * @return void*
  */
 void *stream_calloc(size_t __alignment, size_t vector_len, size_t type_size) {
+  if (mem_node >= 0 || page_mode != PAGES_DEFAULT) {
+    void *ptr = stream_mmap_alloc(vector_len * type_size, mem_node,
+                                  page_mode);
+    if (ptr == NULL) {
+      printf("Error: cannot allocate the vectors (NUMA node %d, %s pages)\n",
+             mem_node, page_mode_name(page_mode));
+      exit(1);
+    }
+    return ptr;
+  }
   return (void *)aligned_alloc(__alignment, vector_len * type_size);
 }
 
+void stream_free(void *ptr) {
+  if (!stream_mmap_free(ptr)) {
+    free(ptr);
+  }
+}
+
 /**
  * @brief
  *
@@ -89,42 +129,123 @@ void *stream_calloc(size_t __alignment, size_t vector_len, size_t type_size) {
  * @param benchmark_fun
  * @param nr_cpu
  * @param nr_streams
+ * @param warmup repetitions left out of the results
  * @return double
  */
 struct benchmark_results execute_mt_benchmark(struct streams_args *th_args, //
                                               void *benchmark_fun(void *),  //
-                                              int nr_cpu, int nr_streams) { //
+                                              int nr_cpu, int nr_streams,   //
+                                              int warmup) {                 //
 
-  sem_t semaphore;
-  sem_init(&semaphore, 0, nr_cpu);
+  struct stream_barrier barrier;
+  stream_barrier_init(&barrier, nr_cpu);
 
-  double avg_time = 0.0;
   double consume_out = 0.0;
 
+  const size_t repetitions = th_args[0].benchmark_repetitions;
+
   pthread_t *threads = malloc(nr_cpu * sizeof(pthread_t));
 
   for (int i = 0; i < nr_cpu; i++) {
-    th_args[i].semaphore = &semaphore;
-    pthread_create(&threads[i], NULL, benchmark_fun, &th_args[i]);
+    th_args[i].barrier = &barrier;
+    th_args[i].start_stamps = malloc(repetitions * sizeof(struct timespec));
+    th_args[i].end_stamps = malloc(repetitions * sizeof(struct timespec));
+    if (create_bound_thread(&threads[i], benchmark_fun, &th_args[i],
+                            thread_cpus[i]) != 0) {
+      // the threads already created would wait forever on the barrier
+      printf("Error: cannot create a thread on CPU %d\n", thread_cpus[i]);
+      exit(1);
+    }
   }
 
   for (int i = 0; i < nr_cpu; i++) {
     pthread_join(threads[i], NULL);
-    avg_time += th_args[i].clock;
     consume_out += th_args[i].consume_out;
   }
-  avg_time /= nr_cpu;
 
-  const double bw = compute_bandwidth(nr_cpu, nr_streams, th_args[0].size,
-                                      avg_time, sizeof(float_type));
+  struct stream_samples *samples =
+      stream_samples_create(nr_cpu, repetitions, warmup);
 
-  struct benchmark_results results = {bw, avg_time, consume_out};
+  for (int i = 0; i < nr_cpu; i++) {
+    for (size_t r = 0; r < repetitions; r++) {
+      stream_samples_set(samples, i, r,
+                         get_time(th_args[i].start_stamps[r],
+                                  th_args[i].end_stamps[r]));
+    }
+  }
+
+  struct benchmark_results results = {0.0, 0.0, consume_out, {0}};
+
+  stream_samples_stats(samples, &results.stats);
+  stream_samples_free(samples);
+
+  results.mean_clock = results.stats.mean;
+  results.total_bandwidth =
+      compute_bandwidth(nr_cpu, nr_streams, th_args[0].size,
+                        results.mean_clock, sizeof(float_type));
+
+  struct timespec *start = malloc(nr_cpu * sizeof(struct timespec));
+  struct timespec *end = malloc(nr_cpu * sizeof(struct timespec));
 
+  for (size_t r = warmup; r < repetitions; r++) {
+    for (int i = 0; i < nr_cpu; i++) {
+      start[i] = th_args[i].start_stamps[r];
+      end[i] = th_args[i].end_stamps[r];
+    }
+    skew_stats_add(&results.skew, start, end, nr_cpu);
+  }
+
+  for (int i = 0; i < nr_cpu; i++) {
+    free(th_args[i].start_stamps);
+    free(th_args[i].end_stamps);
+  }
+  free(start);
+  free(end);
   free(threads);
 
   return results;
 }
 
+/**
+ * @brief Prepares the counters of the calling thread before the start
+ * barrier, opening them on first use, and starts the memory controller
+ * counters: they see the whole system and are driven by the first thread.
+ * The thread counters are started by perf_thread_start after the barrier.
+ *
+ * @param args
+ */
+void perf_region_start(struct streams_args *args) {
+  if (!perf_enabled()) {
+    return;
+  }
+  if (args->thread_id == 0) {
+    perf_imc_start();
+  }
+  perf_thread_open();
+}
+
+/**
+ * @brief Stops the counters of the calling thread, the first thread stops the
+ * memory controller counters once all the threads are done.
+ *
+ * @param args
+ * @param rep the warm-up repetitions are not accumulated
+ */
+void perf_region_stop(struct streams_args *args, const size_t rep) {
+  if (!perf_enabled()) {
+    return;
+  }
+
+  struct perf_values warmup_perf = {{0}};
+  struct perf_values *acc = rep < args->warmup ? &warmup_perf : &args->perf;
+
+  perf_thread_stop(acc);
+  stream_barrier_wait(args->barrier);
+  if (args->thread_id == 0) {
+    perf_imc_stop(acc);
+  }
+}
+
 /**
  * @brief
  *
@@ -153,6 +274,8 @@ void *axpy_thread(void *arg_void) {
     d[i] = 0.0;
   }
 
+  describe_pages(a, args->pages, sizeof(args->pages));
+
   vector_type *a_vec = (vector_type *)(a);
   vector_type *b_vec = (vector_type *)(b);
   vector_type *d_vec = (vector_type *)(d);
@@ -166,15 +289,26 @@ void *axpy_thread(void *arg_void) {
   double consume_out = 0.0;
 
   for (int i = 0; i < args->benchmark_repetitions; i++) {
-    sem_wait(args->semaphore);
+    perf_region_start(args);
+    stream_barrier_wait(args->barrier);
 
+    perf_thread_start();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < size_vec; i++) {
-      d_vec[i] = alpha * a_vec[i] + b_vec[i];
+    if (args->nt_store) {
+      for (size_t j = 0; j < size_vec; j++) {
+        stream_nt_store((float_type *)&d_vec[j], alpha * a_vec[j] + b_vec[j]);
+      }
+      stream_nt_fence();
+    } else {
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = alpha * a_vec[i] + b_vec[i];
+      }
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_region_stop(args, i);
 
-    sem_post(args->semaphore);
+    args->start_stamps[i] = start;
+    args->end_stamps[i] = end;
 
     elapsed += get_time(start, end);
     consume_out += a[rand() % size] + b[rand() % size] + d[rand() % size];
@@ -184,10 +318,10 @@ void *axpy_thread(void *arg_void) {
   args->consume_out = consume_out;
   args->clock = elapsed / args->benchmark_repetitions;
 
-  free(a);
-  free(b);
+  stream_free(a);
+  stream_free(b);
 
-  free(d);
+  stream_free(d);
 
   return NULL;
 }
@@ -216,6 +350,8 @@ void *copy_thread(void *arg_void) {
     d[i] = 0.0;
   }
 
+  describe_pages(a, args->pages, sizeof(args->pages));
+
   vector_type *a_vec = (vector_type *)(a);
   vector_type *d_vec = (vector_type *)(d);
 
@@ -228,15 +364,26 @@ void *copy_thread(void *arg_void) {
 
   for (int i = 0; i < args->benchmark_repetitions; i++) {
 
-    sem_wait(args->semaphore);
+    perf_region_start(args);
+    stream_barrier_wait(args->barrier);
 
+    perf_thread_start();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < size_vec; i++) {
-      d_vec[i] = a_vec[i];
+    if (args->nt_store) {
+      for (size_t j = 0; j < size_vec; j++) {
+        stream_nt_store((float_type *)&d_vec[j], a_vec[j]);
+      }
+      stream_nt_fence();
+    } else {
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i];
+      }
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_region_stop(args, i);
 
-    sem_post(args->semaphore);
+    args->start_stamps[i] = start;
+    args->end_stamps[i] = end;
 
     elapsed += get_time(start, end);
     consume_out += a[rand() % size] + d[rand() % size];
@@ -245,8 +392,8 @@ void *copy_thread(void *arg_void) {
   args->consume_out = consume_out;
   args->clock = elapsed / args->benchmark_repetitions;
 
-  free(a);
-  free(d);
+  stream_free(a);
+  stream_free(d);
 
   return NULL;
 }
@@ -283,6 +430,8 @@ void *FMA_thread(void *arg_void) {
     d[i] = 0.0;
   }
 
+  describe_pages(a, args->pages, sizeof(args->pages));
+
   vector_type *a_vec = (vector_type *)(a);
   vector_type *b_vec = (vector_type *)(b);
   vector_type *c_vec = (vector_type *)(c);
@@ -296,15 +445,26 @@ void *FMA_thread(void *arg_void) {
   double consume_out = 0.0;
 
   for (int i = 0; i < args->benchmark_repetitions; i++) {
-    sem_wait(args->semaphore);
+    perf_region_start(args);
+    stream_barrier_wait(args->barrier);
 
+    perf_thread_start();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < size_vec; i++) {
-      d_vec[i] = a_vec[i] * c_vec[i] + b_vec[i];
+    if (args->nt_store) {
+      for (size_t j = 0; j < size_vec; j++) {
+        stream_nt_store((float_type *)&d_vec[j], a_vec[j] * c_vec[j] + b_vec[j]);
+      }
+      stream_nt_fence();
+    } else {
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i] * c_vec[i] + b_vec[i];
+      }
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_region_stop(args, i);
 
-    sem_post(args->semaphore);
+    args->start_stamps[i] = start;
+    args->end_stamps[i] = end;
 
     elapsed += get_time(start, end);
     consume_out += a[rand() % size] + b[rand() % size] + d[rand() % size];
@@ -313,10 +473,10 @@ void *FMA_thread(void *arg_void) {
   args->consume_out = consume_out;
   args->clock = elapsed / args->benchmark_repetitions;
 
-  free(a);
-  free(b);
-  free(c);
-  free(d);
+  stream_free(a);
+  stream_free(b);
+  stream_free(c);
+  stream_free(d);
 
   return NULL;
 }
@@ -353,6 +513,8 @@ void *add_mult_thread(void *arg_void) {
     d[i] = 0.0;
   }
 
+  describe_pages(a, args->pages, sizeof(args->pages));
+
   vector_type *a_vec = (vector_type *)(a);
   vector_type *b_vec = (vector_type *)(b);
   vector_type *c_vec = (vector_type *)(c);
@@ -366,16 +528,28 @@ void *add_mult_thread(void *arg_void) {
   double consume_out = 0.0;
 
   for (int i = 0; i < args->benchmark_repetitions; i++) {
-    sem_wait(args->semaphore);
+    perf_region_start(args);
+    stream_barrier_wait(args->barrier);
 
+    perf_thread_start();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int i = 0; i < size_vec; i++) {
-      d_vec[i] = a_vec[i] + b_vec[i];
-      c_vec[i] = a_vec[i] * b_vec[i];
+    if (args->nt_store) {
+      for (size_t j = 0; j < size_vec; j++) {
+        stream_nt_store((float_type *)&d_vec[j], a_vec[j] + b_vec[j]);
+        stream_nt_store((float_type *)&c_vec[j], a_vec[j] * b_vec[j]);
+      }
+      stream_nt_fence();
+    } else {
+      for (int i = 0; i < size_vec; i++) {
+        d_vec[i] = a_vec[i] + b_vec[i];
+        c_vec[i] = a_vec[i] * b_vec[i];
+      }
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_region_stop(args, i);
 
-    sem_post(args->semaphore);
+    args->start_stamps[i] = start;
+    args->end_stamps[i] = end;
 
     elapsed += get_time(start, end);
     consume_out += a[rand() % size] + b[rand() % size] + c[rand() % size] +
@@ -385,10 +559,10 @@ void *add_mult_thread(void *arg_void) {
   args->consume_out = consume_out;
   args->clock = elapsed / args->benchmark_repetitions;
 
-  free(a);
-  free(b);
-  free(c);
-  free(d);
+  stream_free(a);
+  stream_free(b);
+  stream_free(c);
+  stream_free(d);
 
   return NULL;
 }
@@ -402,6 +576,21 @@ void *add_mult_thread(void *arg_void) {
  */
 int main(const int argc, const char **argv) {
 
+  // opened first: with csv or json on stdout the report moves to stderr
+  const int output_format =
+      parse_output_format(find_command_line_arg_value(argc, argv, "--output"));
+  if (output_format < 0) {
+    printf("Error: --output must be text, csv or json\n");
+    return 1;
+  }
+
+  FILE *results_out = results_output_open(
+      output_format, find_command_line_arg_value(argc, argv, "--output-file"));
+  if (output_format != OUTPUT_TEXT && results_out == NULL) {
+    printf("Error: cannot open the --output-file\n");
+    return 1;
+  }
+
   printf("Start My Stream [Multi Threads - Local "
          "Memory]\n------------------------\n\n");
 
@@ -424,6 +613,15 @@ int main(const int argc, const char **argv) {
     printf("  -s SIZE                     Size of the vector.\n");
     printf("  -r REPETITIONS              Number of repetitions of each "
            "benchmark.\n");
+    printf(BIND_POLICY_HELP);
+    printf("                              Default: compact.\n");
+    printf(MEMBIND_HELP);
+    printf(PAGES_HELP);
+    printf(STORE_HELP);
+    printf(THREADS_HELP);
+    printf(WARMUP_HELP);
+    printf(OUTPUT_HELP);
+    printf(PERF_HELP);
 
     printf("\n");
     printf("Description:\n");
@@ -465,8 +663,79 @@ int main(const int argc, const char **argv) {
     }
   }
 
+  const char *mem_node_arg = find_command_line_arg_value(argc, argv, "--membind");
+
+  if (mem_node_arg != NULL) {
+    if (is_number(mem_node_arg)) {
+      mem_node = atoi(mem_node_arg);
+      printf("User defined NUMA node of the vectors: %d\n", mem_node);
+    } else {
+      printf("Error: argument of --membind is not numeric\n");
+      return 1;
+    }
+  }
+
+  int warmup = DEFAULT_WARMUP;
+  const char *warmup_arg = find_command_line_arg_value(argc, argv, "--warmup");
+  if (warmup_arg != NULL) {
+    if (!is_number(warmup_arg)) {
+      printf("Error: argument of --warmup is not numeric\n");
+      return 1;
+    }
+    warmup = atoi(warmup_arg);
+  }
+
+  page_mode =
+      parse_page_mode(find_command_line_arg_value(argc, argv, "--pages"));
+  if (page_mode < 0) {
+    printf("Error: --pages must be 4k, thp, 2m or 1g\n");
+    return 1;
+  }
+
+  const int store_mode =
+      parse_store_mode(find_command_line_arg_value(argc, argv, "--store"));
+  if (store_mode == 0) {
+    printf("Error: --store must be regular, nt or both\n");
+    return 1;
+  }
+
   // get the number of cpu from open mp
-  const int nr_cpu = omp_get_num_procs();
+  int nr_cpu = omp_get_num_procs();
+
+  const char *threads_arg = find_command_line_arg_value(argc, argv, "--threads");
+  if (threads_arg != NULL) {
+    int *counts;
+    const int nr_counts = parse_thread_list(threads_arg, &counts);
+    if (nr_counts != 1) {
+      printf("Error: --threads takes a single thread count, the scaling sweep "
+             "is in my_stream_mt_gm\n");
+      free(counts);
+      return 1;
+    }
+    nr_cpu = counts[0];
+    free(counts);
+
+    // oversubscribed threads would time slice
+    if (nr_cpu > nr_allowed_cpus()) {
+      printf("Error: --threads %d exceeds the %d CPUs the process may run "
+             "on\n",
+             nr_cpu, nr_allowed_cpus());
+      return 1;
+    }
+  }
+
+  const char *bind_policy = find_command_line_arg_value(argc, argv, "--bind");
+  if (bind_policy == NULL) {
+    bind_policy = "compact";
+  }
+
+  thread_cpus = make_cpu_binding(bind_policy, nr_cpu);
+  if (thread_cpus == NULL) {
+    printf("Error: invalid --bind policy %s, a CPU not allowed or fewer "
+           "CPUs than the %d threads\n",
+           bind_policy, nr_cpu);
+    return 1;
+  }
   vec_size = vec_size / nr_cpu;
   vec_size = ((vec_size - vec_size % VECTOR_LEN) + VECTOR_LEN) * nr_cpu;
 
@@ -481,74 +750,154 @@ int main(const int argc, const char **argv) {
   printf("GB Vector size:            %f [GB]\n", GB_vec_size);
   printf("GB Total allocated memory: %f [GB]\n", GB_vec_size * 4);
   printf("Repetitions:               %d\n", benchmark_repetitions);
+  print_cpu_binding(bind_policy, thread_cpus, nr_cpu);
   printf("-----------------------------------------------------------\n\n");
 
+  if (flag_exists(argc, argv, "--perf") && perf_init(1)) {
+    printf("IMC counters: %d\n\n", perf_imc_open());
+  }
+
   struct streams_args *th_args = malloc(nr_cpu * sizeof(struct streams_args));
   size_t batch_vec_size = vec_size / nr_cpu;
 
   printf("-----------------------------------------------------------\n");
   printf("Results:\n");
   printf("-----------------------------------------------------------\n\n");
-  printf("Test       bandwidth     mean time\n");
+  printf("Test       bandwidth     mean time      start skew    end skew "
+         "(mean/max)\n");
   printf("-----------------------------------------------------------\n");
 
-  {
-    for (int i = 0; i < nr_cpu; i++) {
-      th_args[i].size = batch_vec_size;
-      th_args[i].benchmark_repetitions = benchmark_repetitions;
-      th_args[i].consume_out = 0.0;
-      th_args[i].clock = 0.0;
+  const struct {
+    const char *label;
+    const char *id;
+    void *(*benchmark_fun)(void *);
+    int nr_streams;
+  } kernels[] = {{"AXPY", "axpy", axpy_thread, 3},
+                 {"Copy", "copy", copy_thread, 2},
+                 {"FMA", "fma", FMA_thread, 4},
+                 {"Add Mul", "add_mult", add_mult_thread, 4}};
+
+  // [kernel][0: regular stores, 1: non-temporal stores], n = 0 if not run
+  struct sample_stats stats[4][2] = {{{0}}};
+  struct perf_values perf[4][2] = {{{{0}}}};
+
+  for (int k = 0; k < 4; k++) {
+    for (int nt = 0; nt < 2; nt++) {
+
+      if (!(store_mode & (nt ? STORE_NT : STORE_REGULAR))) {
+        continue;
+      }
+
+      for (int i = 0; i < nr_cpu; i++) {
+        th_args[i].size = batch_vec_size;
+        th_args[i].benchmark_repetitions = warmup + benchmark_repetitions;
+        th_args[i].consume_out = 0.0;
+        th_args[i].clock = 0.0;
+        th_args[i].nt_store = nt;
+        th_args[i].thread_id = i;
+        th_args[i].warmup = warmup;
+        memset(&th_args[i].perf, 0, sizeof(struct perf_values));
+      }
+
+      struct benchmark_results results =
+          execute_mt_benchmark(th_args, kernels[k].benchmark_fun, nr_cpu,
+                               kernels[k].nr_streams, warmup);
+      stats[k][nt] = results.stats;
+
+      for (int i = 0; i < nr_cpu; i++) {
+        perf_values_add(&perf[k][nt], &th_args[i].perf);
+      }
+
+      char label[32];
+      snprintf(label, sizeof(label), "%s%s:", kernels[k].label,
+               nt ? " nt" : "");
+
+      printf("%-11s %.3f GB/s   %f ms   %.4f/%.4f ms   %.4f/%.4f ms\n", label,
+             results.total_bandwidth / to_GB, results.mean_clock,
+             skew_stats_start_mean(&results.skew), results.skew.start_max,
+             skew_stats_end_mean(&results.skew), results.skew.end_max);
     }
-
-    struct benchmark_results results =
-        execute_mt_benchmark(th_args, axpy_thread, nr_cpu, 3);
-    printf("AXPY:      %.3f GB/s   %f ms\n", results.total_bandwidth / to_GB,
-           results.mean_clock);
   }
+  printf("-----------------------------------------------------------\n");
+  printf("Pages (%s requested):  %s\n\n", page_mode_name(page_mode),
+         th_args[0].pages);
 
-  {
-    for (int i = 0; i < nr_cpu; i++) {
-      th_args[i].size = batch_vec_size;
-      th_args[i].benchmark_repetitions = benchmark_repetitions;
-      th_args[i].consume_out = 0.0;
-      th_args[i].clock = 0.0;
-    }
+  print_sample_stats_header(warmup);
 
-    struct benchmark_results results =
-        execute_mt_benchmark(th_args, copy_thread, nr_cpu, 2);
-    printf("Copy:      %.3f GB/s   %f ms\n", results.total_bandwidth / to_GB,
-           results.mean_clock);
-  }
+  struct results_data results[8];
+  int nr_results = 0;
 
-  {
-    for (int i = 0; i < nr_cpu; i++) {
-      th_args[i].size = batch_vec_size;
-      th_args[i].benchmark_repetitions = benchmark_repetitions;
-      th_args[i].consume_out = 0.0;
-      th_args[i].clock = 0.0;
-    }
+  for (int k = 0; k < 4; k++) {
+    for (int nt = 0; nt < 2; nt++) {
+      if (stats[k][nt].n == 0) {
+        continue;
+      }
+
+      char label[32];
+      snprintf(label, sizeof(label), "%s%s:", kernels[k].label,
+               nt ? " nt" : "");
 
-    struct benchmark_results results =
-        execute_mt_benchmark(th_args, FMA_thread, nr_cpu, 4);
-    printf("FMA:       %.3f GB/s   %f ms\n", results.total_bandwidth / to_GB,
-           results.mean_clock);
+      const double bytes =
+          (double)kernels[k].nr_streams * vec_size * sizeof(float_type);
+
+      print_sample_stats(label, &stats[k][nt], bytes);
+      make_results_data(&results[nr_results++], kernels[k].id, nt,
+                        &stats[k][nt], bytes);
+    }
   }
 
-  {
-    for (int i = 0; i < nr_cpu; i++) {
-      th_args[i].size = batch_vec_size;
-      th_args[i].benchmark_repetitions = benchmark_repetitions;
-      th_args[i].consume_out = 0.0;
-      th_args[i].clock = 0.0;
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n");
+
+  printf("\n");
+
+  if (perf_enabled()) {
+    print_perf_header();
+
+    for (int k = 0; k < 4; k++) {
+      for (int nt = 0; nt < 2; nt++) {
+        if (stats[k][nt].n == 0) {
+          continue;
+        }
+
+        char label[32];
+        snprintf(label, sizeof(label), "%s%s:", kernels[k].label,
+                 nt ? " nt" : "");
+
+        const double bytes = (double)kernels[k].nr_streams * vec_size *
+                             sizeof(float_type) * benchmark_repetitions;
+
+        const double bandwidth_GBS =
+            compute_bandwidth(nr_cpu, kernels[k].nr_streams, batch_vec_size,
+                              stats[k][nt].mean, sizeof(float_type)) /
+            to_GB;
+
+        print_perf_row(label, &perf[k][nt], bytes, bandwidth_GBS);
+      }
     }
 
-    struct benchmark_results results =
-        execute_mt_benchmark(th_args, add_mult_thread, nr_cpu, 4);
-    printf("Add Mul:   %.3f GB/s   %f ms\n", results.total_bandwidth / to_GB,
-           results.mean_clock);
+    printf("-----------------------------------------------------------------"
+           "-------------------------\n\n");
+    perf_imc_close();
   }
-  printf("-----------------------------------------------------------\n");
 
-  printf("\n");
+  const struct results_info info = {.benchmark = "mt_lm",
+                                    .nr_threads = nr_cpu,
+                                    .nr_ranks = 1,
+                                    .binding = bind_policy,
+                                    .pages = th_args[0].pages,
+                                    .vec_size = vec_size,
+                                    .element_size = sizeof(float_type),
+                                    .repetitions = benchmark_repetitions,
+                                    .warmup = warmup};
+
+  if (results_output_write(results_out, output_format, &info, results,
+                           nr_results)) {
+    printf("Error: cannot write the results\n");
+  }
+
+  free(th_args);
+  free(thread_cpus);
+
   return 0;
 }
\ No newline at end of file
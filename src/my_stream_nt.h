@@ -0,0 +1,61 @@
+#ifndef __MY_STREAM_NT__
+#define __MY_STREAM_NT__
+
+/**
+ * Non-temporal (streaming) stores of a block of 8 doubles. They write the
+ * destination without reading it first (no read-for-ownership), so the bus
+ * traffic of a kernel matches the bytes counted by compute_bandwidth.
+ *
+ * x86:     _mm512_stream_pd, _mm256_stream_pd or _mm_stream_pd, depending on
+ *          the instruction set enabled at compile time.
+ * aarch64: stnp (store pair, non-temporal hint).
+ * other:   regular stores.
+ *
+ * A fence (stream_nt_fence) is required before reading the end timestamp:
+ * streaming stores are weakly ordered and may still sit in the write
+ * combining buffers when the loop ends.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+typedef double nt_block_type
+    __attribute__((vector_size(8 * sizeof(double)), aligned(sizeof(double))));
+
+static inline void stream_nt_store(double *dst, const nt_block_type v) {
+#if defined(__AVX512F__)
+  _mm512_stream_pd(dst, (__m512d)v);
+#elif defined(__AVX__)
+  _mm256_stream_pd(dst, _mm256_set_pd(v[3], v[2], v[1], v[0]));
+  _mm256_stream_pd(dst + 4, _mm256_set_pd(v[7], v[6], v[5], v[4]));
+#elif defined(__SSE2__)
+  _mm_stream_pd(dst, _mm_set_pd(v[1], v[0]));
+  _mm_stream_pd(dst + 2, _mm_set_pd(v[3], v[2]));
+  _mm_stream_pd(dst + 4, _mm_set_pd(v[5], v[4]));
+  _mm_stream_pd(dst + 6, _mm_set_pd(v[7], v[6]));
+#elif defined(__aarch64__)
+  __asm__ volatile("stnp %q1, %q2, [%0]\n\t"
+                   "stnp %q3, %q4, [%0, #32]"
+                   :
+                   : "r"(dst), "w"((__Float64x2_t){v[0], v[1]}),
+                     "w"((__Float64x2_t){v[2], v[3]}),
+                     "w"((__Float64x2_t){v[4], v[5]}),
+                     "w"((__Float64x2_t){v[6], v[7]})
+                   : "memory");
+#else
+  *(nt_block_type *)dst = v;
+#endif
+}
+
+static inline void stream_nt_fence(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_sfence();
+#elif defined(__aarch64__)
+  __asm__ volatile("dmb ish" ::: "memory");
+#else
+  __sync_synchronize();
+#endif
+}
+
+#endif // __MY_STREAM_NT__
@@ -0,0 +1,499 @@
+/**
+my_stream
+Copyright (C) 2023
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file my_stream_perf.c
+ * @author Simone Riva (you@domain.com)
+ * @brief Hardware counters read with perf_event_open around the timed regions.
+ * @version 0.1
+ * @date 2023-12-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "my_stream_perf.h"
+#include "my_stream_utils.h"
+
+#define PERF_IMC_MAX_FDS 256
+
+static const char *perf_event_names[PERF_NR_EVENTS] = {
+    "cycles", "instructions", "LLC-misses", "dTLB-load-misses"};
+
+static int perf_on = 0;
+static int perf_available[PERF_NR_EVENTS] = {0};
+
+static pthread_key_t perf_key;
+static pthread_once_t perf_key_once = PTHREAD_ONCE_INIT;
+
+/* the events of a thread: grouped[e] is set for the leader and the members
+ * of its group, the others are opened on their own. last[e] keeps the value,
+ * time enabled and time running read at the end of the previous region. */
+struct perf_thread {
+  int fd[PERF_NR_EVENTS];
+  int grouped[PERF_NR_EVENTS];
+  int leader;
+  uint64_t last[PERF_NR_EVENTS][3];
+};
+
+static int imc_fd[PERF_IMC_MAX_FDS];
+static int imc_nr_fds = 0;
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                            int group_fd, unsigned long flags) {
+  return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static void perf_event_attr_init(struct perf_event_attr *attr, const int id) {
+  memset(attr, 0, sizeof(struct perf_event_attr));
+  attr->size = sizeof(struct perf_event_attr);
+  attr->disabled = 1;
+  // the times scale the counts when the events are multiplexed
+  attr->read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // user space only, this is what perf_event_paranoid 2 still allows
+  attr->exclude_kernel = 1;
+  attr->exclude_hv = 1;
+
+  switch (id) {
+  case PERF_CYCLES:
+    attr->type = PERF_TYPE_HARDWARE;
+    attr->config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case PERF_INSTRUCTIONS:
+    attr->type = PERF_TYPE_HARDWARE;
+    attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case PERF_LLC_MISSES:
+    attr->type = PERF_TYPE_HARDWARE;
+    attr->config = PERF_COUNT_HW_CACHE_MISSES;
+    break;
+  case PERF_DTLB_MISSES:
+    attr->type = PERF_TYPE_HW_CACHE;
+    attr->config = PERF_COUNT_HW_CACHE_DTLB |
+                   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    break;
+  }
+}
+
+/**
+ * @brief Opens the available events of the calling thread as one group led by
+ * the first of them: the members are enabled with their leader, so that a
+ * single ioctl starts the whole group. An event that does not fit the group
+ * (e.g. not enough programmable counters) is opened on its own.
+ *
+ * @param fd
+ * @param grouped set for the events of the group, may be NULL
+ * @param only_available
+ * @param error the errno of the first event that cannot be opened, may be
+ * NULL
+ * @return int the number of opened events
+ */
+static int perf_open_events(int *fd, int *grouped, const int only_available,
+                            int *error) {
+  int leader = -1;
+  int opened = 0;
+
+  for (int e = 0; e < PERF_NR_EVENTS; e++) {
+    fd[e] = -1;
+    if (grouped != NULL) {
+      grouped[e] = 0;
+    }
+    if (only_available && !perf_available[e]) {
+      continue;
+    }
+
+    struct perf_event_attr attr;
+    perf_event_attr_init(&attr, e);
+
+    int in_group = 1;
+    if (leader >= 0) {
+      attr.disabled = 0;
+      fd[e] = perf_event_open(&attr, 0, -1, leader, 0);
+      if (fd[e] < 0) {
+        attr.disabled = 1;
+        in_group = 0;
+        fd[e] = perf_event_open(&attr, 0, -1, -1, 0);
+      }
+    } else {
+      fd[e] = perf_event_open(&attr, 0, -1, -1, 0);
+    }
+
+    if (fd[e] < 0) {
+      if (error != NULL && *error == 0) {
+        *error = errno;
+      }
+      continue;
+    }
+
+    if (leader < 0) {
+      leader = fd[e];
+    }
+    if (grouped != NULL) {
+      grouped[e] = in_group;
+    }
+    opened++;
+  }
+
+  return opened;
+}
+
+static void perf_thread_destroy(void *ptr) {
+  struct perf_thread *pt = (struct perf_thread *)ptr;
+  for (int e = 0; e < PERF_NR_EVENTS; e++) {
+    if (pt->fd[e] >= 0) {
+      close(pt->fd[e]);
+    }
+  }
+  free(pt);
+}
+
+static void perf_key_create(void) {
+  // closes the descriptors of threads that exit (--spawn)
+  pthread_key_create(&perf_key, perf_thread_destroy);
+}
+
+static struct perf_thread *perf_thread_get(void) {
+  pthread_once(&perf_key_once, perf_key_create);
+
+  struct perf_thread *pt = pthread_getspecific(perf_key);
+  if (pt == NULL) {
+    pt = calloc(1, sizeof(struct perf_thread));
+    perf_open_events(pt->fd, pt->grouped, 1, NULL);
+
+    pt->leader = -1;
+    for (int e = 0; e < PERF_NR_EVENTS && pt->leader < 0; e++) {
+      if (pt->grouped[e]) {
+        pt->leader = pt->fd[e];
+      }
+    }
+    pthread_setspecific(perf_key, pt);
+  }
+
+  return pt;
+}
+
+int perf_init(const int verbose) {
+  int fd[PERF_NR_EVENTS];
+  int error = 0;
+  const int opened = perf_open_events(fd, NULL, 0, &error);
+
+  for (int e = 0; e < PERF_NR_EVENTS; e++) {
+    perf_available[e] = fd[e] >= 0;
+    if (fd[e] >= 0) {
+      close(fd[e]);
+    }
+  }
+
+  if (verbose) {
+    printf("Perf counters:");
+    for (int e = 0; e < PERF_NR_EVENTS; e++) {
+      printf(" %s %s%s", perf_event_names[e],
+             perf_available[e] ? "ok" : "n/a",
+             e < PERF_NR_EVENTS - 1 ? "," : "\n");
+    }
+  }
+
+  if (opened == 0) {
+    if (!verbose) {
+      return 0;
+    }
+
+    int paranoid = -1;
+    FILE *file = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if (file != NULL) {
+      if (fscanf(file, "%d", &paranoid) != 1) {
+        paranoid = -1;
+      }
+      fclose(file);
+    }
+    printf("Perf counters unavailable (%s, perf_event_paranoid %d), "
+           "--perf ignored\n",
+           strerror(error), paranoid);
+    return 0;
+  }
+
+  perf_on = 1;
+  return opened;
+}
+
+int perf_enabled(void) { return perf_on; }
+
+void perf_thread_open(void) {
+  if (!perf_on) {
+    return;
+  }
+
+  perf_thread_get();
+}
+
+void perf_thread_start(void) {
+  if (!perf_on) {
+    return;
+  }
+
+  struct perf_thread *pt = perf_thread_get();
+  if (pt->leader >= 0) {
+    ioctl(pt->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+  for (int e = 0; e < PERF_NR_EVENTS; e++) {
+    if (pt->fd[e] >= 0 && !pt->grouped[e]) {
+      ioctl(pt->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void perf_thread_stop(struct perf_values *acc) {
+  if (!perf_on) {
+    return;
+  }
+
+  struct perf_thread *pt = perf_thread_get();
+  if (pt->leader >= 0) {
+    ioctl(pt->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  }
+  for (int e = 0; e < PERF_NR_EVENTS; e++) {
+    if (pt->fd[e] >= 0 && !pt->grouped[e]) {
+      ioctl(pt->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  for (int e = 0; e < PERF_NR_EVENTS; e++) {
+    // value, time enabled, time running: all of them since the open
+    uint64_t now[3];
+    if (pt->fd[e] < 0 ||
+        read(pt->fd[e], now, sizeof(now)) != (ssize_t)sizeof(now)) {
+      continue;
+    }
+
+    const double value = (double)(now[0] - pt->last[e][0]);
+    const double enabled = (double)(now[1] - pt->last[e][1]);
+    const double running = (double)(now[2] - pt->last[e][2]);
+    memcpy(pt->last[e], now, sizeof(now));
+
+    // a multiplexed event counted only a part of the region
+    if (running > 0.0) {
+      acc->count[e] += running < enabled ? value * enabled / running : value;
+    }
+  }
+}
+
+/**
+ * @brief Reads a sysfs event description like "event=0x04,umask=0x03" into
+ * the config of an uncore event.
+ *
+ * @param path
+ * @param config
+ * @return int 0 on success
+ */
+static int perf_read_event_config(const char *path, uint64_t *config) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return 1;
+  }
+
+  char line[256];
+  const int ok = fgets(line, sizeof(line), file) != NULL;
+  fclose(file);
+  if (!ok) {
+    return 1;
+  }
+
+  *config = 0;
+  for (char *term = strtok(line, ",\n"); term != NULL;
+       term = strtok(NULL, ",\n")) {
+    unsigned long value;
+    if (sscanf(term, "event=%lx", &value) == 1) {
+      *config |= value & 0xff;
+    } else if (sscanf(term, "umask=%lx", &value) == 1) {
+      *config |= (value & 0xff) << 8;
+    }
+  }
+
+  return 0;
+}
+
+int perf_imc_open(void) {
+  static const char *events[] = {"cas_count_read", "cas_count_write"};
+  const char *root = "/sys/bus/event_source/devices";
+
+  DIR *dir = opendir(root);
+  if (dir == NULL) {
+    return 0;
+  }
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, "uncore_imc", 10) != 0) {
+      continue;
+    }
+
+    char path[512];
+    char text[256];
+    int type;
+
+    snprintf(path, sizeof(path), "%s/%s/type", root, entry->d_name);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+      continue;
+    }
+    const int ok = fscanf(file, "%d", &type) == 1;
+    fclose(file);
+    if (!ok) {
+      continue;
+    }
+
+    // the uncore counts per socket, on any one of the cpus of the mask
+    snprintf(path, sizeof(path), "%s/%s/cpumask", root, entry->d_name);
+    file = fopen(path, "r");
+    if (file == NULL) {
+      continue;
+    }
+    const int have_mask = fgets(text, sizeof(text), file) != NULL;
+    fclose(file);
+    if (!have_mask) {
+      continue;
+    }
+    text[strcspn(text, "\n")] = '\0';
+
+    int *cpus = NULL;
+    const int nr_cpus = parse_cpulist(text, &cpus);
+
+    for (int ev = 0; ev < 2; ev++) {
+      uint64_t config;
+      snprintf(path, sizeof(path), "%s/%s/events/%s", root, entry->d_name,
+               events[ev]);
+      if (perf_read_event_config(path, &config)) {
+        continue;
+      }
+
+      for (int i = 0; i < nr_cpus && imc_nr_fds < PERF_IMC_MAX_FDS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+
+        const int fd = perf_event_open(&attr, -1, cpus[i], -1, 0);
+        if (fd >= 0) {
+          imc_fd[imc_nr_fds++] = fd;
+        }
+      }
+    }
+
+    free(cpus);
+  }
+
+  closedir(dir);
+
+  return imc_nr_fds;
+}
+
+void perf_imc_start(void) {
+  for (int i = 0; i < imc_nr_fds; i++) {
+    ioctl(imc_fd[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(imc_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+void perf_imc_stop(struct perf_values *acc) {
+  for (int i = 0; i < imc_nr_fds; i++) {
+    ioctl(imc_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  for (int i = 0; i < imc_nr_fds; i++) {
+    uint64_t value;
+    if (read(imc_fd[i], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+      acc->imc_bytes += (double)value * CACHE_LINE_SIZE;
+    }
+  }
+}
+
+void perf_imc_close(void) {
+  for (int i = 0; i < imc_nr_fds; i++) {
+    close(imc_fd[i]);
+  }
+  imc_nr_fds = 0;
+}
+
+void perf_values_add(struct perf_values *acc, const struct perf_values *v) {
+  for (int e = 0; e < PERF_NR_EVENTS; e++) {
+    acc->count[e] += v->count[e];
+  }
+  acc->imc_bytes += v->imc_bytes;
+}
+
+void print_perf_header(void) {
+  printf("Hardware counters (per algorithmic byte, LLC misses in %d byte "
+         "lines):\n",
+         CACHE_LINE_SIZE);
+  printf("---------------------------------------------------------------------"
+         "---------------------\n");
+  printf("Benchmark:          GB/s        IPC   LLC miss B/B  dTLB miss/MiB"
+         "    IMC B/B   IMC GB/s\n");
+  printf("---------------------------------------------------------------------"
+         "---------------------\n");
+}
+
+void print_perf_row(const char *label, const struct perf_values *v,
+                    const double bytes, const double bandwidth_GBs) {
+  char ipc[16] = "n/a";
+  char llc[16] = "n/a";
+  char dtlb[16] = "n/a";
+  char imc[16] = "n/a";
+  char imc_GBs[16] = "n/a";
+
+  if (perf_available[PERF_CYCLES] && perf_available[PERF_INSTRUCTIONS] &&
+      v->count[PERF_CYCLES] > 0.0) {
+    snprintf(ipc, sizeof(ipc), "%.3f",
+             v->count[PERF_INSTRUCTIONS] / v->count[PERF_CYCLES]);
+  }
+  if (perf_available[PERF_LLC_MISSES]) {
+    snprintf(llc, sizeof(llc), "%.3f",
+             v->count[PERF_LLC_MISSES] * CACHE_LINE_SIZE / bytes);
+  }
+  if (perf_available[PERF_DTLB_MISSES]) {
+    snprintf(dtlb, sizeof(dtlb), "%.2f",
+             v->count[PERF_DTLB_MISSES] / (bytes / (1024.0 * 1024.0)));
+  }
+  if (imc_nr_fds > 0) {
+    // the IMC window also covers the thread dispatch, a slight overestimate
+    snprintf(imc, sizeof(imc), "%.3f", v->imc_bytes / bytes);
+    snprintf(imc_GBs, sizeof(imc_GBs), "%.2f",
+             bandwidth_GBs * v->imc_bytes / bytes);
+  }
+
+  printf("%-14s%10.2f %10s %14s %14s %10s %10s\n", label, bandwidth_GBs, ipc,
+         llc, dtlb, imc, imc_GBs);
+}
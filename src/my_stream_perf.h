@@ -0,0 +1,141 @@
+/**
+my_stream
+Copyright (C) 2023
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file my_stream_perf.h
+ * @author Simone Riva (you@domain.com)
+ * @brief Hardware counters read with perf_event_open around the timed regions.
+ * @version 0.1
+ * @date 2023-12-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef __MY_STREAM_PERF__
+#define __MY_STREAM_PERF__
+
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_LLC_MISSES 2
+#define PERF_DTLB_MISSES 3
+#define PERF_NR_EVENTS 4
+
+/**
+ * @brief Counts accumulated over threads and repetitions. imc_bytes are the
+ * CAS reads and writes of the memory controllers times the cache line size,
+ * they count the whole system and not only the benchmark.
+ */
+struct perf_values {
+  double count[PERF_NR_EVENTS];
+  double imc_bytes;
+};
+
+#define PERF_HELP                                                              \
+  "  --perf                      Read cycles, instructions, LLC and dTLB "     \
+  "misses\n"                                                                   \
+  "                              around each timed region, and the memory "    \
+  "controller\n"                                                               \
+  "                              CAS counts when the uncore PMU is "           \
+  "accessible.\n"
+
+/**
+ * @brief Probes the counters in the calling thread and enables the
+ * instrumentation for the events that can be opened. When none can be opened
+ * (e.g. perf_event_paranoid or a container without a PMU) prints why and
+ * leaves the instrumentation off.
+ *
+ * @param verbose print the available events
+ * @return int the number of available core events
+ */
+int perf_init(const int verbose);
+
+/**
+ * @brief
+ *
+ * @return int nonzero after a successful perf_init
+ */
+int perf_enabled(void);
+
+/**
+ * @brief Opens the counters of the calling thread if they are not yet open.
+ * Call it before the start barrier, so that perf_event_open is not timed.
+ * No-op when the instrumentation is off.
+ */
+void perf_thread_open(void);
+
+/**
+ * @brief Enables the counters of the calling thread with a single ioctl on
+ * the group leader, opening them on first use. Call it after the start
+ * barrier, so that the counts do not include the wait. No-op when the
+ * instrumentation is off.
+ */
+void perf_thread_start(void);
+
+/**
+ * @brief Disables the counters of the calling thread and adds their values
+ * since perf_thread_start to acc, scaled by the time enabled over the time
+ * running when the events were multiplexed. No-op when the instrumentation
+ * is off.
+ *
+ * @param acc
+ */
+void perf_thread_stop(struct perf_values *acc);
+
+/**
+ * @brief Opens the CAS counters of the uncore_imc PMUs, one per socket.
+ *
+ * @return int the number of opened counters, 0 if none is available
+ */
+int perf_imc_open(void);
+
+void perf_imc_start(void);
+
+/**
+ * @brief
+ *
+ * @param acc imc_bytes is incremented by the CAS count times the line size
+ */
+void perf_imc_stop(struct perf_values *acc);
+
+void perf_imc_close(void);
+
+/**
+ * @brief
+ *
+ * @param acc
+ * @param v
+ */
+void perf_values_add(struct perf_values *acc, const struct perf_values *v);
+
+void print_perf_header(void);
+
+/**
+ * @brief Prints the counters next to the bandwidth. The miss columns are
+ * normalised by the algorithmic bytes, an LLC miss ratio above 1 (in lines of
+ * 64 bytes) shows RFO or prefetch overfetch.
+ *
+ * @param label
+ * @param v counts summed over threads and repetitions
+ * @param bytes algorithmic bytes of all the repetitions in v
+ * @param bandwidth_GBs
+ */
+void print_perf_row(const char *label, const struct perf_values *v,
+                    const double bytes, const double bandwidth_GBs);
+
+#endif
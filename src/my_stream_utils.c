@@ -1,19 +1,34 @@
 
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
 #include <math.h>
 #include <omp.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "my_stream_perf.h"
 #include "my_stream_utils.h"
 
 const char *find_command_line_arg_value(const int argc, const char *argv[],
                                         const char *arg) {
 
+  const size_t len = strlen(arg);
+
   for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], arg, len) == 0 && argv[i][len] == '=') {
+      return argv[i] + len + 1; // --arg=value
+    }
     if (strcmp(argv[i], arg) == 0) {
       if (i + 1 < argc && argv[i + 1][0] != '-') {
         return argv[i + 1]; // Return pointer to the value
@@ -25,21 +40,6 @@ const char *find_command_line_arg_value(const int argc, const char *argv[],
   return NULL; // Argument not found
 }
 
-const int find_command_line_arg_value_v2(const int argc, const char *argv[],
-                                         const char *arg) {
-
-  for (int i = 1; i < argc; i++) {
-    if (strcmp(argv[i], arg) == 0) {
-      if (i + 1 < argc && argv[i + 1][0] != '-') {
-        return i + 1; // Return pointer to the value
-      } else {
-        return -1; // No value or next argument is a command
-      }
-    }
-  }
-  return -1; // Argument not found
-}
-
 int flag_exists(const int argc, const char *argv[], const char *flag) {
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], flag) == 0) {
@@ -182,6 +182,14 @@ void print_help(const char *argv[]) {
   printf("  -s SIZE                     Size of the vector.\n");
   printf("  -r REPETITIONS              Number of repetitions of each "
          "benchmark.\n");
+  printf(BIND_POLICY_HELP);
+  printf(MEMBIND_HELP);
+  printf(PAGES_HELP);
+  printf(STORE_HELP);
+  printf(THREADS_HELP);
+  printf(WARMUP_HELP);
+  printf(OUTPUT_HELP);
+  printf(PERF_HELP);
 
   printf("\n");
   printf("Description:\n");
@@ -206,68 +214,1518 @@ void print_performance_metrics(double bandwidth_axpy, double avg_clock_axpy,
   printf("-----------------------------------------------------------\n");
   printf("AXPY:         %10.3f [GB/s]         %10.3f [ms]\n",
          bandwidth_axpy / to_GB, avg_clock_axpy);
-  printf("FMA:          %10.3f [GB/s]         %10.3f [ms]\n",
-         bandwidth_fma / to_GB, avg_clock_fma);
   printf("COPY:         %10.3f [GB/s]         %10.3f [ms]\n",
          bandwidth_copy / to_GB, avg_clock_copy);
+  printf("FMA:          %10.3f [GB/s]         %10.3f [ms]\n",
+         bandwidth_fma / to_GB, avg_clock_fma);
   printf("ADDMUL:       %10.3f [GB/s]         %10.3f [ms]\n",
          bandwidth_addmul / to_GB, avg_clock_addmul);
   printf("-----------------------------------------------------------\n\n");
 }
 
-char *make_results_csv(const struct results_data *results, const int n) {
-  // Initial buffer size with room for headers and data
-  size_t buffer_size = 1024;
-  char *csv = malloc(buffer_size);
+/**
+ * Appends a formatted string to a growing buffer.
+ *
+ * @return 0 on success, -1 if the buffer cannot be enlarged.
+ */
+static int buffer_printf(char **buffer, size_t *size, size_t *len,
+                         const char *format, ...) {
+  for (;;) {
+    va_list ap;
+    va_start(ap, format);
+    const int written = vsnprintf(*buffer + *len, *size - *len, format, ap);
+    va_end(ap);
+
+    if (written < 0) {
+      return -1;
+    }
+
+    if ((size_t)written < *size - *len) {
+      *len += written;
+      return 0;
+    }
+
+    const size_t new_size = 2 * (*size) + written;
+    char *new_buffer = realloc(*buffer, new_size);
+    if (!new_buffer) {
+      return -1;
+    }
+    *buffer = new_buffer;
+    *size = new_size;
+  }
+}
+
+#ifndef COMPILER
+#define COMPILER "unknown"
+#endif
+
+#ifndef ARCHITECTURE
+#define ARCHITECTURE "unknown"
+#endif
+
+/**
+ * Fills a row of results from the statistics of its repetitions.
+ *
+ * @param result    The row.
+ * @param test_name Name of the kernel.
+ * @param nt_store  1 if the kernel used non-temporal stores.
+ * @param stats     Statistics of the repetitions.
+ * @param bytes     Bytes moved by one repetition.
+ */
+void make_results_data(struct results_data *result, const char *test_name,
+                       const int nt_store, const struct sample_stats *stats,
+                       const double bytes) {
+  memset(result, 0, sizeof(struct results_data));
+
+  snprintf(result->test_name, sizeof(result->test_name), "%s", test_name);
+  result->nt_store = nt_store;
+  result->repetitions = stats->n;
+  result->avg_time = stats->mean;
+  result->std_dev = stats->std_dev;
+  result->max = stats->max;
+  result->min = stats->min;
+  result->median = stats->median;
+  result->p90 = stats->p90;
+  result->p99 = stats->p99;
+  result->outliers = stats->outliers;
+  result->bytes = bytes;
+  result->streamed_memory = bytes / to_MB;
+
+  if (stats->mean > 0.0) {
+    result->bandwidth = bytes / stats->mean * 1000.0 / to_GB;
+  }
+  if (stats->min > 0.0) {
+    result->best_bandwidth = bytes / stats->min * 1000.0 / to_GB;
+  }
+}
+
+/**
+ * Formats the results as CSV, one row per kernel, the description of the run
+ * is repeated on every row.
+ *
+ * @return The CSV text, to be freed by the caller, NULL on failure.
+ */
+char *make_results_csv(const struct results_info *info,
+                       const struct results_data *results, const int n) {
+  size_t size = 1024;
+  size_t len = 0;
+  char *csv = malloc(size);
   if (!csv) {
     return NULL;
   }
-  char *csv_ptr = csv;
-  size_t remaining = buffer_size;
-  int written;
 
-  // Write header
-  written = snprintf(csv_ptr, remaining,
-                     "Test, Avg. Time [ms], Bandwidth [GB/s], Std. Dev. [ms], "
-                     "Max [ms], Min [ms], Streamed Memory [MB]\n");
+  int err = buffer_printf(
+      &csv, &size, &len,
+      "benchmark,test,nt_store,threads,ranks,binding,pages,vector_size,"
+      "repetitions,warmup,bytes,bandwidth_gbs,best_bandwidth_gbs,avg_time_ms,"
+      "min_time_ms,median_time_ms,p90_time_ms,p99_time_ms,max_time_ms,"
+      "std_dev_ms,outliers,compiler,architecture\n");
 
-  if (written < 0 || written >= remaining) {
+  for (int i = 0; i < n && !err; i++) {
+    const struct results_data *r = &results[i];
+    err = buffer_printf(
+        &csv, &size, &len,
+        "%s,%s,%d,%d,%d,\"%s\",%s,%lu,%d,%d,%.0f,%f,%f,%f,%f,%f,%f,%f,%f,%f,"
+        "%d,\"%s\",%s\n",
+        info->benchmark, r->test_name, r->nt_store, info->nr_threads,
+        info->nr_ranks, info->binding, info->pages, info->vec_size,
+        r->repetitions, info->warmup, r->bytes, r->bandwidth,
+        r->best_bandwidth, r->avg_time, r->min, r->median, r->p90, r->p99,
+        r->max, r->std_dev, r->outliers, COMPILER, ARCHITECTURE);
+  }
+
+  if (err) {
     free(csv);
     return NULL;
   }
 
-  csv_ptr += written;
-  remaining -= written;
+  return csv;
+}
+
+/**
+ * Formats the description of the run and the results as a JSON document.
+ *
+ * @return The JSON text, to be freed by the caller, NULL on failure.
+ */
+char *make_results_json(const struct results_info *info,
+                        const struct results_data *results, const int n) {
+  size_t size = 4096;
+  size_t len = 0;
+  char *json = malloc(size);
+  if (!json) {
+    return NULL;
+  }
+
+  int err = buffer_printf(
+      &json, &size, &len,
+      "{\n"
+      "  \"benchmark\": \"%s\",\n"
+      "  \"compiler\": \"%s\",\n"
+      "  \"architecture\": \"%s\",\n"
+      "  \"threads\": %d,\n"
+      "  \"ranks\": %d,\n"
+      "  \"binding\": \"%s\",\n"
+      "  \"pages\": \"%s\",\n"
+      "  \"vector_size\": %lu,\n"
+      "  \"element_size\": %lu,\n"
+      "  \"repetitions\": %d,\n"
+      "  \"warmup\": %d,\n"
+      "  \"results\": [",
+      info->benchmark, COMPILER, ARCHITECTURE, info->nr_threads,
+      info->nr_ranks, info->binding, info->pages, info->vec_size,
+      info->element_size, info->repetitions, info->warmup);
+
+  for (int i = 0; i < n && !err; i++) {
+    const struct results_data *r = &results[i];
+    err = buffer_printf(&json, &size, &len,
+                        "%s\n    {\n"
+                        "      \"test\": \"%s\",\n"
+                        "      \"nt_store\": %s,\n"
+                        "      \"repetitions\": %d,\n"
+                        "      \"bytes\": %.0f,\n"
+                        "      \"bandwidth_gbs\": %f,\n"
+                        "      \"best_bandwidth_gbs\": %f,\n"
+                        "      \"time_ms\": {\"avg\": %f, \"min\": %f, "
+                        "\"median\": %f, \"p90\": %f, \"p99\": %f, "
+                        "\"max\": %f, \"std_dev\": %f},\n"
+                        "      \"outliers\": %d\n"
+                        "    }",
+                        i ? "," : "", r->test_name,
+                        r->nt_store ? "true" : "false", r->repetitions,
+                        r->bytes, r->bandwidth, r->best_bandwidth, r->avg_time,
+                        r->min, r->median, r->p90, r->p99, r->max, r->std_dev,
+                        r->outliers);
+  }
+
+  if (!err) {
+    err = buffer_printf(&json, &size, &len, "\n  ]\n}\n");
+  }
+
+  if (err) {
+    free(json);
+    return NULL;
+  }
+
+  return json;
+}
+
+/**
+ * Parses the argument of --output.
+ *
+ * @param arg text, csv or json, NULL for the default (text).
+ * @return    The OUTPUT_* format, -1 if arg is not valid.
+ */
+int parse_output_format(const char *arg) {
+  if (arg == NULL || strcmp(arg, "text") == 0) {
+    return OUTPUT_TEXT;
+  }
+  if (strcmp(arg, "csv") == 0) {
+    return OUTPUT_CSV;
+  }
+  if (strcmp(arg, "json") == 0) {
+    return OUTPUT_JSON;
+  }
+  return -1;
+}
+
+/**
+ * Opens the destination of the machine readable results. When they go to
+ * stdout, the text report is moved to stderr so that stdout carries only the
+ * CSV or JSON document.
+ *
+ * @param format The OUTPUT_* format.
+ * @param path   The output file, NULL for stdout.
+ * @return       The stream, NULL for the text format or if path cannot be
+ *               opened.
+ */
+FILE *results_output_open(const int format, const char *path) {
+  if (format == OUTPUT_TEXT) {
+    return NULL;
+  }
+
+  if (path != NULL) {
+    return fopen(path, "w");
+  }
+
+  fflush(stdout);
+  const int fd = dup(STDOUT_FILENO);
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+
+  return fdopen(fd, "w");
+}
+
+/**
+ * Writes the results in the given format and closes the stream.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int results_output_write(FILE *out, const int format,
+                         const struct results_info *info,
+                         const struct results_data *results, const int n) {
+  if (out == NULL) {
+    return 0;
+  }
+
+  char *text = format == OUTPUT_JSON ? make_results_json(info, results, n)
+                                     : make_results_csv(info, results, n);
+  if (text == NULL) {
+    fclose(out);
+    return 1;
+  }
+
+  fputs(text, out);
+  free(text);
+
+  return fclose(out) != 0;
+}
+
+/**
+ * Pins the given thread on a single CPU.
+ *
+ * @param thread The thread to pin.
+ * @param cpu    The CPU index, a negative value leaves the thread unpinned.
+ * @return       0 on success, the pthread error code otherwise.
+ */
+int bind_thread_to_cpu(pthread_t thread, const int cpu) {
+  if (cpu < 0) {
+    return 0;
+  }
+
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+
+  return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpu_set);
+}
+
+/**
+ * Creates a thread that is already pinned on cpu when it starts, so that
+ * the pages it touches first are allocated on its own NUMA node.
+ *
+ * @param thread The created thread.
+ * @param fun    The thread function.
+ * @param arg    The argument of fun.
+ * @param cpu    The CPU index, a negative value leaves the thread unpinned.
+ * @return       0 on success, the pthread error code otherwise.
+ */
+int create_bound_thread(pthread_t *thread, void *fun(void *), void *arg,
+                        const int cpu) {
+  if (cpu < 0) {
+    return pthread_create(thread, NULL, fun, arg);
+  }
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpu_set);
+
+  const int err = pthread_create(thread, &attr, fun, arg);
+  pthread_attr_destroy(&attr);
+
+  return err;
+}
+
+struct cpu_topology {
+  int cpu;
+  int package;
+  int core;
+};
+
+static int read_sysfs_int(const char *path, const int default_value) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return default_value;
+  }
+
+  int value = default_value;
+  if (fscanf(f, "%d", &value) != 1) {
+    value = default_value;
+  }
+  fclose(f);
+
+  return value;
+}
+
+static int compare_topology(const void *x, const void *y) {
+  const struct cpu_topology *a = (const struct cpu_topology *)x;
+  const struct cpu_topology *b = (const struct cpu_topology *)y;
+
+  if (a->package != b->package) {
+    return a->package - b->package;
+  }
+  if (a->core != b->core) {
+    return a->core - b->core;
+  }
+  return a->cpu - b->cpu;
+}
+
+/**
+ * Reads the topology of the CPUs this process is allowed to run on, sorted
+ * by package, core and CPU index.
+ *
+ * @param topology The topology, to be released with free().
+ * @return         The number of CPUs.
+ */
+static int read_cpu_topology(struct cpu_topology **topology) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(cpu_set_t), &allowed);
+
+  const int n = CPU_COUNT(&allowed);
+  *topology = malloc(n * sizeof(struct cpu_topology));
+
+  char path[256];
+  int k = 0;
+
+  for (int cpu = 0; cpu < CPU_SETSIZE && k < n; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed)) {
+      continue;
+    }
+
+    (*topology)[k].cpu = cpu;
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+             cpu);
+    (*topology)[k].package = read_sysfs_int(path, 0);
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    (*topology)[k].core = read_sysfs_int(path, cpu);
+
+    k++;
+  }
+
+  qsort(*topology, k, sizeof(struct cpu_topology), compare_topology);
+
+  return k;
+}
+
+/**
+ * Parses a cpulist (i.e. "0-3,8,10-11").
+ *
+ * @param list The cpulist.
+ * @param cpus The parsed CPUs, to be released with free().
+ * @return     The number of CPUs, 0 if the list is malformed.
+ */
+int parse_cpulist(const char *list, int **cpus) {
+  int capacity = 64;
+  int n = 0;
+  *cpus = malloc(capacity * sizeof(int));
+
+  const char *p = list;
+  while (*p != '\0') {
+    char *next;
+    const long first = strtol(p, &next, 10);
+    long last = first;
+
+    if (next == p || first < 0) {
+      n = 0;
+      break;
+    }
+
+    p = next;
+    if (*p == '-') {
+      p++;
+      last = strtol(p, &next, 10);
+      if (next == p || last < first) {
+        n = 0;
+        break;
+      }
+      p = next;
+    }
+
+    for (long cpu = first; cpu <= last; cpu++) {
+      if (n == capacity) {
+        capacity *= 2;
+        *cpus = realloc(*cpus, capacity * sizeof(int));
+      }
+      (*cpus)[n++] = (int)cpu;
+    }
+
+    if (*p == ',') {
+      p++;
+    } else if (*p != '\0') {
+      n = 0;
+      break;
+    }
+  }
+
+  return n;
+}
+
+/**
+ * Reads a cpulist (or a node list) from a sysfs file.
+ *
+ * @param path The file.
+ * @param list The parsed list, to be released with free().
+ * @return     The number of elements, 0 when the file is empty or missing.
+ */
+static int read_sysfs_list(const char *path, int **list) {
+  char buffer[4096] = {0};
+
+  FILE *f = fopen(path, "r");
+  if (f) {
+    if (fgets(buffer, sizeof(buffer), f) == NULL) {
+      buffer[0] = '\0';
+    }
+    fclose(f);
+  }
+
+  buffer[strcspn(buffer, "\n")] = '\0';
+
+  if (buffer[0] == '\0') {
+    *list = malloc(sizeof(int));
+    return 0;
+  }
+
+  return parse_cpulist(buffer, list);
+}
+
+/**
+ * Parses the argument of --threads: a thread count or a list of counts and
+ * ranges (i.e. "1-4,8,16").
+ *
+ * @param arg     The list.
+ * @param threads The thread counts, to be released with free(), NULL if
+ *                the list is malformed.
+ * @return        The number of counts, 0 if the list is malformed.
+ */
+int parse_thread_list(const char *arg, int **threads) {
+  const int n = parse_cpulist(arg, threads);
+
+  int valid = n > 0;
+  for (int i = 0; i < n && valid; i++) {
+    valid = (*threads)[i] > 0;
+  }
+
+  if (!valid) {
+    free(*threads);
+    *threads = NULL;
+    return 0;
+  }
+
+  return n;
+}
+
+/**
+ * Counts the CPUs the process is allowed to run on (taskset, cgroup cpuset).
+ *
+ * @return The number of CPUs in the affinity mask.
+ */
+int nr_allowed_cpus(void) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0) {
+    return sysconf(_SC_NPROCESSORS_ONLN);
+  }
+
+  return CPU_COUNT(&allowed);
+}
+
+/**
+ * Lists the online NUMA nodes, including the nodes without CPUs (i.e. CXL
+ * memory expanders).
+ *
+ * @param nodes The nodes, to be released with free().
+ * @return      The number of nodes.
+ */
+int numa_nodes(int **nodes) {
+  const int n = read_sysfs_list("/sys/devices/system/node/online", nodes);
+
+  if (n == 0) {
+    (*nodes)[0] = 0;
+    return 1;
+  }
+
+  return n;
+}
+
+/**
+ * Lists the CPUs of a NUMA node the process is allowed to run on (taskset,
+ * cgroup cpuset).
+ *
+ * @param node  The NUMA node.
+ * @param cpus  The CPUs, to be released with free().
+ * @return      The number of CPUs, 0 for memory only nodes and for nodes
+ *              without allowed CPUs.
+ */
+int numa_node_cpus(const int node, int **cpus) {
+  char path[256];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+           node);
+
+  const int n = read_sysfs_list(path, cpus);
 
-  // Write data rows
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(cpu_set_t), &allowed);
+
+  int k = 0;
   for (int i = 0; i < n; i++) {
-    written = snprintf(csv_ptr, remaining, "%s, %lf, %lf, %lf, %lf, %lf, %lf\n",
-                       results[i].test_name, results[i].avg_time,
-                       results[i].bandwidth, results[i].std_dev, results[i].max,
-                       results[i].min, results[i].streamed_memory);
-
-    if (written < 0 || written >= remaining) {
-      // Buffer too small, reallocate with double size
-      size_t new_size = buffer_size * 2;
-      char *new_csv = realloc(csv, new_size);
-      if (!new_csv) {
-        free(csv);
-        return NULL;
+    if ((*cpus)[i] < CPU_SETSIZE && CPU_ISSET((*cpus)[i], &allowed)) {
+      (*cpus)[k++] = (*cpus)[i];
+    }
+  }
+
+  return k;
+}
+
+/**
+ * Computes the CPU of each thread for the given binding policy.
+ *
+ * @param policy     none, compact, scatter, cores or a cpulist.
+ * @param nr_threads The number of threads.
+ * @return           The CPU of each thread (-1 means not pinned), NULL if
+ *                   the policy is not valid, lists a CPU the process is
+ *                   not allowed to run on or fewer CPUs than threads. To be
+ *                   released with free().
+ */
+int *make_cpu_binding(const char *policy, const int nr_threads) {
+  int *binding = malloc(nr_threads * sizeof(int));
+
+  if (policy == NULL || strcmp(policy, "none") == 0) {
+    for (int i = 0; i < nr_threads; i++) {
+      binding[i] = -1;
+    }
+    return binding;
+  }
+
+  if (policy[0] >= '0' && policy[0] <= '9') {
+    int *cpus;
+    const int n = parse_cpulist(policy, &cpus);
+
+    // a CPU outside the affinity mask would make pthread_create() fail
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(cpu_set_t), &allowed);
+
+    // two threads on a CPU would time slice, as --threads refuses
+    int valid = n >= nr_threads;
+    for (int i = 0; i < n && valid; i++) {
+      valid = cpus[i] < CPU_SETSIZE && CPU_ISSET(cpus[i], &allowed);
+    }
+
+    if (!valid) {
+      free(cpus);
+      free(binding);
+      return NULL;
+    }
+
+    for (int i = 0; i < nr_threads; i++) {
+      binding[i] = cpus[i];
+    }
+    free(cpus);
+    return binding;
+  }
+
+  struct cpu_topology *topology;
+  const int nr_cpus = read_cpu_topology(&topology);
+
+  if (strcmp(policy, "compact") == 0) {
+
+    for (int i = 0; i < nr_threads; i++) {
+      binding[i] = topology[i % nr_cpus].cpu;
+    }
+
+  } else if (strcmp(policy, "cores") == 0) {
+
+    // the first CPU of each physical core
+    int nr_cores = 0;
+    for (int i = 0; i < nr_cpus; i++) {
+      if (i == 0 || topology[i].package != topology[i - 1].package ||
+          topology[i].core != topology[i - 1].core) {
+        topology[nr_cores++] = topology[i];
       }
+    }
 
-      csv = new_csv;
-      csv_ptr = csv + (buffer_size - remaining);
-      remaining = new_size - (buffer_size - remaining);
-      buffer_size = new_size;
+    for (int i = 0; i < nr_threads; i++) {
+      binding[i] = topology[i % nr_cores].cpu;
+    }
 
-      // Retry writing this row
-      i--;
-      continue;
+  } else if (strcmp(policy, "scatter") == 0) {
+
+    // pick one CPU per socket in turn, each socket in compact order
+    int *next = calloc(nr_cpus + 1, sizeof(int));
+    int *first = calloc(nr_cpus + 1, sizeof(int));
+    int nr_packages = 0;
+
+    for (int i = 0; i < nr_cpus; i++) {
+      if (i == 0 || topology[i].package != topology[i - 1].package) {
+        first[nr_packages++] = i;
+      }
+    }
+    first[nr_packages] = nr_cpus;
+
+    for (int i = 0; i < nr_threads; i++) {
+      const int p = i % nr_packages;
+      const int size = first[p + 1] - first[p];
+      binding[i] = topology[first[p] + next[p] % size].cpu;
+      next[p]++;
     }
 
-    csv_ptr += written;
-    remaining -= written;
+    free(next);
+    free(first);
+
+  } else {
+    free(binding);
+    binding = NULL;
   }
 
-  return csv;
-}
\ No newline at end of file
+  free(topology);
+  return binding;
+}
+
+/**
+ * Computes the CPUs of a latency probe (thread 0) and of nr_threads - 1 load
+ * threads. With compact, cores or scatter the load threads never share the
+ * physical core of the probe, whose L1 and fill buffers they would contend
+ * for: they take one CPU per core in cores order from the core after the
+ * probe, then the SMT siblings of those cores. none and cpulists are kept as
+ * given.
+ *
+ * @param policy     none, compact, scatter, cores or a cpulist.
+ * @param nr_threads The number of threads, probe included.
+ * @return           The CPU of each thread, NULL if the policy is not valid.
+ *                   To be released with free().
+ */
+int *make_probe_cpu_binding(const char *policy, const int nr_threads) {
+  if (policy == NULL || strcmp(policy, "none") == 0 ||
+      (policy[0] >= '0' && policy[0] <= '9')) {
+    return make_cpu_binding(policy, nr_threads);
+  }
+
+  int *binding = make_cpu_binding(policy, nr_threads);
+  if (binding == NULL) {
+    return NULL;
+  }
+
+  struct cpu_topology *topology;
+  const int nr_cpus = read_cpu_topology(&topology);
+
+  // the probe keeps the first CPU of the policy
+  int probe = 0;
+  while (probe < nr_cpus && topology[probe].cpu != binding[0]) {
+    probe++;
+  }
+
+  int *load = malloc(nr_cpus * sizeof(int));
+  int nr_load = 0;
+
+  // pass 0: the first CPU of each core, pass 1: its siblings, both starting
+  // after the core of the probe
+  for (int pass = 0; pass < 2 && probe < nr_cpus; pass++) {
+    for (int k = 1; k <= nr_cpus; k++) {
+      const int i = (probe + k) % nr_cpus;
+      const int first_of_core =
+          i == 0 || topology[i].package != topology[i - 1].package ||
+          topology[i].core != topology[i - 1].core;
+
+      if (topology[i].package == topology[probe].package &&
+          topology[i].core == topology[probe].core) {
+        continue;
+      }
+      if (first_of_core == (pass == 0)) {
+        load[nr_load++] = topology[i].cpu;
+      }
+    }
+  }
+
+  // a single core: nothing to keep apart
+  for (int i = 1; i < nr_threads && nr_load > 0; i++) {
+    binding[i] = load[(i - 1) % nr_load];
+  }
+
+  free(load);
+  free(topology);
+  return binding;
+}
+
+/**
+ * Prints the thread to CPU mapping.
+ */
+void print_cpu_binding(const char *policy, const int *cpus,
+                       const int nr_threads) {
+  printf("CPU binding:               %s\n", policy ? policy : "none");
+
+  if (cpus == NULL || cpus[0] < 0) {
+    return;
+  }
+
+  printf("Thread -> CPU:             ");
+  for (int i = 0; i < nr_threads; i++) {
+    if (i > 0) {
+      printf(i % 8 == 0 ? "\n                           " : " ");
+    }
+    printf("%d->%d", i, cpus[i]);
+  }
+  printf("\n");
+}
+
+/**
+ * Parses the argument of --store.
+ *
+ * @param arg regular, nt, both or NULL (regular).
+ * @return    A combination of STORE_REGULAR and STORE_NT, 0 if not valid.
+ */
+int parse_store_mode(const char *arg) {
+  if (arg == NULL || strcmp(arg, "regular") == 0) {
+    return STORE_REGULAR;
+  }
+  if (strcmp(arg, "nt") == 0) {
+    return STORE_NT;
+  }
+  if (strcmp(arg, "both") == 0) {
+    return STORE_BOTH;
+  }
+  return 0;
+}
+
+/**
+ * Finds the NUMA node of a CPU.
+ *
+ * @param cpu The CPU index.
+ * @return    The NUMA node, 0 when the topology is not available.
+ */
+int cpu_to_numa_node(const int cpu) {
+  char path[256];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+  DIR *dir = opendir(path);
+  if (!dir) {
+    return 0;
+  }
+
+  int node = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, "node", 4) == 0 &&
+        is_number(entry->d_name + 4) && entry->d_name[4] != '\0') {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+
+  return node;
+}
+
+/**
+ * Sets the memory policy of the calling thread so that the pages it touches
+ * first are placed on the given NUMA node when possible.
+ *
+ * @param node The NUMA node, a negative value restores the default policy.
+ * @return     0 on success, -1 otherwise.
+ */
+int set_preferred_numa_node(const int node) {
+  if (node < 0) {
+    return (int)syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+  }
+
+  unsigned long mask[16] = {0};
+  const int bits = 8 * sizeof(unsigned long);
+
+  if (node >= 16 * bits) {
+    return -1;
+  }
+  mask[node / bits] = 1UL << (node % bits);
+
+  return (int)syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, 16 * bits + 1);
+}
+
+#define MAX_MMAP_ALLOCATIONS 4096
+
+/* allocations done by stream_mmap_alloc, needed by munmap */
+static struct {
+  void *ptr;
+  size_t bytes;
+} mmap_allocations[MAX_MMAP_ALLOCATIONS];
+
+static pthread_mutex_t mmap_allocations_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Parses the argument of --pages.
+ *
+ * @param arg 4k, thp, 2m, 1g or NULL (default).
+ * @return    The PAGES_* mode, -1 if not valid.
+ */
+int parse_page_mode(const char *arg) {
+  if (arg == NULL) {
+    return PAGES_DEFAULT;
+  }
+
+  const char *names[] = {"default", "4k", "thp", "2m", "1g"};
+  for (int i = 0; i < 5; i++) {
+    if (strcmp(arg, names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char *page_mode_name(const int mode) {
+  const char *names[] = {"default", "4k", "thp", "2m", "1g"};
+  return (mode >= 0 && mode < 5) ? names[mode] : "unknown";
+}
+
+/**
+ * Reads from /proc/self/smaps the pages backing the mapping that contains ptr.
+ *
+ * @param ptr  An address of the mapping, i.e. a vector after its first touch.
+ * @param info The size of the mapping, its kernel page size and the bytes
+ *             backed by transparent huge pages.
+ * @return     0 on success, -1 if the mapping is not found.
+ */
+int read_page_info(const void *ptr, struct page_info *info) {
+  FILE *smaps = fopen("/proc/self/smaps", "r");
+  if (!smaps) {
+    return -1;
+  }
+
+  const unsigned long addr = (unsigned long)ptr;
+  char line[512];
+  int found = 0;
+
+  memset(info, 0, sizeof(struct page_info));
+
+  while (fgets(line, sizeof(line), smaps)) {
+    unsigned long start, end;
+    size_t kb;
+
+    // mapping header: start-end perms offset dev inode path
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+      if (found) {
+        break;
+      }
+      found = addr >= start && addr < end;
+      continue;
+    }
+
+    if (!found) {
+      continue;
+    }
+
+    if (sscanf(line, "Size: %lu kB", &kb) == 1) {
+      info->mapping_bytes = kb * 1024;
+    } else if (sscanf(line, "KernelPageSize: %lu kB", &kb) == 1) {
+      info->page_bytes = kb * 1024;
+    } else if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+      info->thp_bytes = kb * 1024;
+    }
+  }
+
+  fclose(smaps);
+
+  return found ? 0 : -1;
+}
+
+/**
+ * Describes the pages backing the vector at ptr: "1G", "2M" (hugetlbfs),
+ * "4K + THP xx%" or "4K".
+ */
+const char *describe_pages(const void *ptr, char *buffer, const size_t len) {
+  struct page_info info;
+
+  if (read_page_info(ptr, &info) != 0) {
+    snprintf(buffer, len, "unknown");
+  } else if (info.page_bytes >= ((size_t)1 << 30)) {
+    snprintf(buffer, len, "%luG", info.page_bytes >> 30);
+  } else if (info.page_bytes >= ((size_t)1 << 20)) {
+    snprintf(buffer, len, "%luM", info.page_bytes >> 20);
+  } else if (info.thp_bytes > 0 && info.mapping_bytes > 0) {
+    snprintf(buffer, len, "%luK + THP %.0f%%", info.page_bytes >> 10,
+             100.0 * info.thp_bytes / info.mapping_bytes);
+  } else {
+    snprintf(buffer, len, "%luK", info.page_bytes >> 10);
+  }
+
+  return buffer;
+}
+
+/**
+ * Allocates memory with mmap, bound to a NUMA node when node >= 0 and backed
+ * by the requested kind of pages. When the hugetlbfs pool cannot serve the
+ * request the allocation falls back to transparent huge pages. The pages
+ * are not touched, so the kernels run unchanged on this memory.
+ *
+ * @param bytes The size of the allocation.
+ * @param node  The NUMA node, a negative value means no binding.
+ * @param pages One of the PAGES_* modes.
+ * @return      The page aligned memory, NULL on failure.
+ */
+void *stream_mmap_alloc(size_t bytes, const int node, const int pages) {
+  void *ptr = MAP_FAILED;
+  int advice = pages;
+
+  if (pages == PAGES_2M || pages == PAGES_1G) {
+    const int shift = pages == PAGES_2M ? 21 : 30;
+    const size_t page_size = (size_t)1 << shift;
+    const size_t huge_bytes = (bytes + page_size - 1) & ~(page_size - 1);
+
+    ptr = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                   (shift << MAP_HUGE_SHIFT),
+               -1, 0);
+
+    if (ptr != MAP_FAILED) {
+      bytes = huge_bytes;
+    } else {
+      advice = PAGES_THP;
+    }
+  }
+
+  if (ptr == MAP_FAILED) {
+    ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+      return NULL;
+    }
+
+    if (advice == PAGES_THP) {
+      madvise(ptr, bytes, MADV_HUGEPAGE);
+    } else if (advice == PAGES_4K) {
+      madvise(ptr, bytes, MADV_NOHUGEPAGE);
+    }
+  }
+
+  if (node >= 0) {
+    unsigned long mask[16] = {0};
+    const int bits = 8 * sizeof(unsigned long);
+
+    if (node >= 16 * bits) {
+      munmap(ptr, bytes);
+      return NULL;
+    }
+    mask[node / bits] = 1UL << (node % bits);
+
+    if (syscall(SYS_mbind, ptr, bytes, MPOL_BIND, mask, 16 * bits + 1,
+                MPOL_MF_STRICT) != 0) {
+      munmap(ptr, bytes);
+      return NULL;
+    }
+  }
+
+  pthread_mutex_lock(&mmap_allocations_lock);
+
+  int slot = 0;
+  while (slot < MAX_MMAP_ALLOCATIONS && mmap_allocations[slot].ptr != NULL) {
+    slot++;
+  }
+
+  if (slot < MAX_MMAP_ALLOCATIONS) {
+    mmap_allocations[slot].ptr = ptr;
+    mmap_allocations[slot].bytes = bytes;
+  }
+
+  pthread_mutex_unlock(&mmap_allocations_lock);
+
+  if (slot == MAX_MMAP_ALLOCATIONS) {
+    munmap(ptr, bytes);
+    return NULL;
+  }
+
+  return ptr;
+}
+
+/**
+ * Releases memory allocated by stream_mmap_alloc.
+ *
+ * @param ptr The memory.
+ * @return    1 if ptr was allocated by stream_mmap_alloc, 0 otherwise.
+ */
+int stream_mmap_free(void *ptr) {
+  if (ptr == NULL) {
+    return 0;
+  }
+
+  size_t bytes = 0;
+
+  pthread_mutex_lock(&mmap_allocations_lock);
+  for (int i = 0; i < MAX_MMAP_ALLOCATIONS; i++) {
+    if (mmap_allocations[i].ptr == ptr) {
+      bytes = mmap_allocations[i].bytes;
+      mmap_allocations[i].ptr = NULL;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mmap_allocations_lock);
+
+  if (bytes == 0) {
+    return 0;
+  }
+
+  munmap(ptr, bytes);
+  return 1;
+}
+
+#define POOL_SPINS_BEFORE_YIELD 4096
+
+struct stream_pool_worker {
+  struct stream_pool *pool;
+  int id;
+};
+
+/**
+ * Spins until *value differs from old_value, yielding the CPU from time to
+ * time so that oversubscribed runs still make progress.
+ */
+static void pool_wait_change(const unsigned int *value,
+                             const unsigned int old_value) {
+  unsigned int spins = 0;
+  while (__atomic_load_n(value, __ATOMIC_ACQUIRE) == old_value) {
+    if (++spins == POOL_SPINS_BEFORE_YIELD) {
+      spins = 0;
+      sched_yield();
+    }
+  }
+}
+
+static void *pool_worker_main(void *arg_void) {
+  struct stream_pool_worker *worker = (struct stream_pool_worker *)arg_void;
+  struct stream_pool *pool = worker->pool;
+
+  unsigned int generation = 0;
+
+  for (;;) {
+    pool_wait_change(&pool->generation, generation);
+    generation = __atomic_load_n(&pool->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&pool->shutdown, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+
+    pool->task(pool->task_args + worker->id * pool->task_args_size);
+
+    __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+  }
+
+  return NULL;
+}
+
+/**
+ * Creates a pool of nr_threads workers.
+ *
+ * @param nr_threads The number of workers.
+ * @param cpus       The CPU of each worker, or NULL to leave them unpinned.
+ * @return           The pool, NULL on failure.
+ */
+struct stream_pool *stream_pool_create(const int nr_threads, const int *cpus) {
+  struct stream_pool *pool = calloc(1, sizeof(struct stream_pool));
+  if (!pool) {
+    return NULL;
+  }
+
+  pool->nr_threads = nr_threads;
+  pool->threads = malloc(nr_threads * sizeof(pthread_t));
+  pool->workers = malloc(nr_threads * sizeof(struct stream_pool_worker));
+
+  if (!pool->threads || !pool->workers) {
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+    return NULL;
+  }
+
+  for (int i = 0; i < nr_threads; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].id = i;
+    if (create_bound_thread(&pool->threads[i], pool_worker_main,
+                            &pool->workers[i], cpus ? cpus[i] : -1) != 0) {
+      // join only the workers already running
+      pool->nr_threads = i;
+      stream_pool_destroy(pool);
+      return NULL;
+    }
+  }
+
+  return pool;
+}
+
+/**
+ * Runs task on every worker of the pool and waits for all of them.
+ *
+ * @param pool      The pool.
+ * @param task      The function executed by each worker.
+ * @param args      Array of nr_threads arguments, worker i gets the i-th one.
+ * @param args_size The size of a single element of args.
+ */
+void stream_pool_run(struct stream_pool *pool, void *task(void *), void *args,
+                     const size_t args_size) {
+  pool->task = task;
+  pool->task_args = (char *)args;
+  pool->task_args_size = args_size;
+
+  __atomic_store_n(&pool->pending, pool->nr_threads, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&pool->generation, 1, __ATOMIC_ACQ_REL);
+
+  unsigned int spins = 0;
+  while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) > 0) {
+    if (++spins == POOL_SPINS_BEFORE_YIELD) {
+      spins = 0;
+      sched_yield();
+    }
+  }
+}
+
+/**
+ * Stops and joins the workers, then releases the pool.
+ */
+void stream_pool_destroy(struct stream_pool *pool) {
+  if (!pool) {
+    return;
+  }
+
+  __atomic_store_n(&pool->shutdown, 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&pool->generation, 1, __ATOMIC_ACQ_REL);
+
+  for (int i = 0; i < pool->nr_threads; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  free(pool->threads);
+  free(pool->workers);
+  free(pool);
+}
+
+/**
+ * Initializes a barrier for nr_threads threads.
+ */
+void stream_barrier_init(struct stream_barrier *barrier, const int nr_threads) {
+  barrier->nr_threads = nr_threads;
+  barrier->count = nr_threads;
+  barrier->generation = 0;
+}
+
+/**
+ * Blocks until nr_threads threads have reached the barrier.
+ */
+void stream_barrier_wait(struct stream_barrier *barrier) {
+  const unsigned int generation =
+      __atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE);
+
+  if (__atomic_sub_fetch(&barrier->count, 1, __ATOMIC_ACQ_REL) == 0) {
+    __atomic_store_n(&barrier->count, barrier->nr_threads, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&barrier->generation, 1, __ATOMIC_ACQ_REL);
+  } else {
+    pool_wait_change(&barrier->generation, generation);
+  }
+}
+
+/**
+ * Computes the distance between the earliest and the latest time stamp.
+ *
+ * @param stamps The time stamps.
+ * @param n      The number of time stamps.
+ * @return       The spread in milliseconds.
+ */
+double timespec_spread(const struct timespec *stamps, const int n) {
+  int first = 0;
+  int last = 0;
+
+  for (int i = 1; i < n; i++) {
+    if (get_time(stamps[i], stamps[first]) > 0.0) {
+      first = i;
+    }
+    if (get_time(stamps[last], stamps[i]) > 0.0) {
+      last = i;
+    }
+  }
+
+  return get_time(stamps[first], stamps[last]);
+}
+
+/**
+ * Adds the start and end spread of one repetition to the statistics.
+ *
+ * @param stats The statistics.
+ * @param start The start time stamp of each thread.
+ * @param end   The end time stamp of each thread.
+ * @param n     The number of threads.
+ */
+void skew_stats_add(struct skew_stats *stats, const struct timespec *start,
+                    const struct timespec *end, const int n) {
+  const double start_spread = timespec_spread(start, n);
+  const double end_spread = timespec_spread(end, n);
+
+  stats->start_sum += start_spread;
+  stats->end_sum += end_spread;
+
+  if (stats->n == 0 || start_spread > stats->start_max) {
+    stats->start_max = start_spread;
+  }
+  if (stats->n == 0 || end_spread > stats->end_max) {
+    stats->end_max = end_spread;
+  }
+
+  stats->n++;
+}
+
+double skew_stats_start_mean(const struct skew_stats *stats) {
+  return stats->n > 0 ? stats->start_sum / stats->n : 0.0;
+}
+
+double skew_stats_end_mean(const struct skew_stats *stats) {
+  return stats->n > 0 ? stats->end_sum / stats->n : 0.0;
+}
+
+/**
+ * @brief Links the cache lines of buffer into a single random cycle.
+ *
+ * Sattolo's shuffle of the line indices gives one cycle through every line, so
+ * the chase visits the whole working set before repeating and the hardware
+ * prefetchers cannot guess the next address. The first word of each line
+ * holds the address of the next line.
+ *
+ * @param buffer Working set, at least two cache lines.
+ * @param bytes Size of buffer in bytes.
+ * @param seed Seed of generate_random_number, same seed gives the same chain.
+ * @return size_t Number of lines in the chain.
+ */
+size_t make_pointer_chain(void *buffer, const size_t bytes,
+                                 unsigned int seed) {
+  const size_t nr_lines = bytes / CACHE_LINE_SIZE;
+  size_t *order = malloc(nr_lines * sizeof(size_t));
+
+  for (size_t i = 0; i < nr_lines; i++) {
+    order[i] = i;
+  }
+
+  for (size_t i = nr_lines - 1; i > 0; i--) {
+    // the generator has 31 bits of state, two draws cover any working set
+    const unsigned int hi = seed = generate_random_number(seed);
+    const unsigned int lo = seed = generate_random_number(seed);
+    const size_t j = (((size_t)(hi >> 8) << 23) ^ (lo >> 8)) % i;
+
+    const size_t tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+
+  char *base = buffer;
+  for (size_t i = 0; i < nr_lines; i++) {
+    const size_t next = order[(i + 1) % nr_lines];
+    *(void **)(base + order[i] * CACHE_LINE_SIZE) =
+        base + next * CACHE_LINE_SIZE;
+  }
+
+  free(order);
+  return nr_lines;
+}
+
+/**
+ * @brief Applies updates XOR updates to random entries of table. The batch
+ * sequences are independent, their addresses are computed before the loads so
+ * that batch misses can be in flight at once.
+ *
+ * @param table 1 << table_bits entries
+ * @param table_bits at most 31, the bits of generate_random_number
+ * @param updates rounded down to a multiple of batch
+ * @param batch 1 .. GUPS_MAX_BATCH
+ * @param seed different for each thread or rank
+ */
+void gups_update(uint64_t *table, const int table_bits, const size_t updates,
+                 const int batch, const unsigned int seed) {
+  // the high bits: the low bits of a power of two LCG have short periods
+  const int shift = 31 - table_bits;
+
+  unsigned int r[GUPS_MAX_BATCH];
+  for (int b = 0; b < batch; b++) {
+    r[b] = generate_random_number(seed * GUPS_MAX_BATCH + b + 1);
+  }
+
+  for (size_t u = 0; u + batch <= updates; u += batch) {
+    for (int b = 0; b < batch; b++) {
+      r[b] = generate_random_number(r[b]);
+    }
+    for (int b = 0; b < batch; b++) {
+      table[r[b] >> shift] ^= r[b];
+    }
+  }
+}
+
+/**
+ * @brief
+ *
+ * @param bytes
+ * @return int log2 of the largest power of two of 8 byte entries in bytes,
+ * at most 31
+ */
+int gups_table_bits(const size_t bytes) {
+  int bits = 0;
+  while (bits < 31 && ((size_t)2 << bits) * sizeof(uint64_t) <= bytes) {
+    bits++;
+  }
+  return bits;
+}
+
+/**
+ * @brief Follows the chain for loads dependent loads.
+ *
+ * @param chain Any line of a chain built by make_pointer_chain.
+ * @param loads Number of loads, rounded down to a multiple of 8.
+ * @return void* The last line reached, to be consumed by the caller.
+ */
+void *chase_pointers(void *chain, const size_t loads) {
+  void **p = chain;
+
+  for (size_t i = 0; i < loads; i += 8) {
+    p = (void **)*p;
+    p = (void **)*p;
+    p = (void **)*p;
+    p = (void **)*p;
+    p = (void **)*p;
+    p = (void **)*p;
+    p = (void **)*p;
+    p = (void **)*p;
+  }
+
+  return p;
+}
+
+/**
+ * Allocates the samples of nr_repetitions repetitions (warm-up included) of
+ * nr_threads threads.
+ */
+struct stream_samples *stream_samples_create(const int nr_threads,
+                                             const int nr_repetitions,
+                                             const int warmup) {
+  struct stream_samples *samples = malloc(sizeof(struct stream_samples));
+
+  samples->nr_threads = nr_threads;
+  samples->nr_repetitions = nr_repetitions;
+  samples->warmup = warmup < nr_repetitions ? warmup : nr_repetitions - 1;
+  samples->clock = calloc((size_t)nr_threads * nr_repetitions, sizeof(double));
+
+  return samples;
+}
+
+void stream_samples_set(struct stream_samples *samples, const int thread,
+                        const int repetition, const double clock) {
+  samples->clock[(size_t)thread * samples->nr_repetitions + repetition] = clock;
+}
+
+void stream_samples_free(struct stream_samples *samples) {
+  if (!samples) {
+    return;
+  }
+  free(samples->clock);
+  free(samples);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Percentile p (0 - 1) of a sorted vector, linear interpolation between the
+ * closest ranks.
+ */
+static double sorted_percentile(const double *sorted, const int n,
+                                const double p) {
+  const double pos = p * (double)(n - 1);
+  const int lo = (int)pos;
+
+  if (lo + 1 >= n) {
+    return sorted[n - 1];
+  }
+  return sorted[lo] + (pos - (double)lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+/**
+ * Computes min, median, p90, p99, max, mean, standard deviation, MAD and the
+ * number of outliers of the n samples in v.
+ */
+void sample_stats_compute(const double *v, const int n,
+                          struct sample_stats *stats) {
+  memset(stats, 0, sizeof(struct sample_stats));
+  if (n <= 0) {
+    return;
+  }
+
+  double *sorted = malloc(n * sizeof(double));
+  memcpy(sorted, v, n * sizeof(double));
+  qsort(sorted, n, sizeof(double), compare_doubles);
+
+  stats->n = n;
+  stats->mean = average(v, n);
+  stats->std_dev = std_dev(v, n);
+  stats->min = sorted[0];
+  stats->max = sorted[n - 1];
+  stats->median = sorted_percentile(sorted, n, 0.5);
+  stats->p90 = sorted_percentile(sorted, n, 0.9);
+  stats->p99 = sorted_percentile(sorted, n, 0.99);
+
+  for (int i = 0; i < n; i++) {
+    sorted[i] = fabs(v[i] - stats->median);
+  }
+  qsort(sorted, n, sizeof(double), compare_doubles);
+  stats->mad = sorted_percentile(sorted, n, 0.5);
+
+  // modified z-score of Iglewicz and Hoaglin: 0.6745 (x - median) / MAD
+  for (int i = 0; i < n && stats->mad > 0.0; i++) {
+    if (0.6745 * fabs(v[i] - stats->median) / stats->mad > 3.5) {
+      stats->outliers++;
+    }
+  }
+
+  free(sorted);
+}
+
+/**
+ * Statistics of the repetitions after the warm-up, the time of a repetition
+ * is the one of its slowest thread: the window in which all of them streamed,
+ * so that a single stalled thread shows up in the distribution.
+ */
+void stream_samples_stats(const struct stream_samples *samples,
+                          struct sample_stats *stats) {
+  const int n = samples->nr_repetitions - samples->warmup;
+  double *rep_clock = calloc(n, sizeof(double));
+
+  for (int r = 0; r < n; r++) {
+    for (int t = 0; t < samples->nr_threads; t++) {
+      const double clock = samples->clock[(size_t)t * samples->nr_repetitions +
+                                          samples->warmup + r];
+      if (clock > rep_clock[r]) {
+        rep_clock[r] = clock;
+      }
+    }
+  }
+
+  sample_stats_compute(rep_clock, n, stats);
+  free(rep_clock);
+}
+
+void print_sample_stats_header(const int warmup) {
+  printf("Statistics of the repetitions (%d warm-up dropped), best rate from "
+         "the min time:\n",
+         warmup);
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n");
+  printf("Test          Best [GB/s]   Min [ms] Median [ms]  p90 [ms]  p99 [ms] "
+         "Stddev [ms]  Outliers\n");
+  printf("-----------------------------------------------------------------"
+         "-------------------------\n");
+}
+
+/**
+ * Prints a row of statistics, bytes are the bytes moved by one repetition.
+ * Outliers are flagged with a '!'.
+ */
+void print_sample_stats(const char *label, const struct sample_stats *stats,
+                        const double bytes) {
+  const double best = stats->min > 0.0 ? bytes / stats->min * 1000.0 / to_GB
+                                       : 0.0;
+
+  char outliers[32];
+  snprintf(outliers, sizeof(outliers), "%d/%d%s", stats->outliers, stats->n,
+           stats->outliers ? " !" : "");
+
+  printf("%-14s%11.2f %10.3f %11.3f %9.3f %9.3f %11.3f  %s\n", label, best,
+         stats->min, stats->median, stats->p90, stats->p99, stats->std_dev,
+         outliers);
+}
@@ -1,14 +1,17 @@
 #ifndef __MY_STREAM_UTILS__
 #define __MY_STREAM_UTILS__
 
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
 static const double to_MB = (1024.0 * 1024.0);
 static const double to_GB = (1024.0 * 1024.0 * 1024.0);
 
 const char *find_command_line_arg_value(const int argc, const char *argv[], const char *arg);
 
-const int find_command_line_arg_value_v2(const int argc, const char *argv[],
-                                         const char *arg);
-
 int flag_exists(const int argc, const char *argv[], const char *flag);
 
 int is_number(const char *str);
@@ -43,14 +46,311 @@ void print_performance_metrics(double bandwidth_axpy, double avg_clock_axpy,
 
 struct results_data {
   char test_name[100];
+  int nt_store;
+  int repetitions;
   double avg_time;
   double bandwidth;
+  double best_bandwidth;
   double std_dev;
   double max;
   double min;
+  double median;
+  double p90;
+  double p99;
+  int outliers;
+  double bytes;
   double streamed_memory;
 };
 
-char *make_results_csv(const struct results_data *results, const int n);
+/**
+ * Description of a run, written with the results.
+ */
+struct results_info {
+  const char *benchmark;
+  int nr_threads;
+  int nr_ranks;
+  const char *binding;
+  const char *pages;
+  size_t vec_size;
+  size_t element_size;
+  int repetitions;
+  int warmup;
+};
+
+struct sample_stats;
+
+void make_results_data(struct results_data *result, const char *test_name,
+                       const int nt_store, const struct sample_stats *stats,
+                       const double bytes);
+
+char *make_results_csv(const struct results_info *info,
+                       const struct results_data *results, const int n);
+
+char *make_results_json(const struct results_info *info,
+                        const struct results_data *results, const int n);
+
+#define OUTPUT_TEXT 0
+#define OUTPUT_CSV 1
+#define OUTPUT_JSON 2
+
+#define OUTPUT_HELP                                                            \
+  "  --output FORMAT             text (default), csv or json. csv and json "   \
+  "go to\n"                                                                    \
+  "                              stdout (the text report moves to stderr) "    \
+  "or to\n"                                                                    \
+  "                              --output-file PATH.\n"
+
+int parse_output_format(const char *arg);
+
+FILE *results_output_open(const int format, const char *path);
+
+int results_output_write(FILE *out, const int format,
+                         const struct results_info *info,
+                         const struct results_data *results, const int n);
+
+/**
+ * Persistent pool of worker threads. The workers are created once and then
+ * spin (yielding after a while) until a new task is published, so every
+ * repetition starts from already running threads.
+ */
+struct stream_pool {
+  int nr_threads;
+  pthread_t *threads;
+  struct stream_pool_worker *workers;
+
+  void *(*task)(void *);
+  char *task_args;
+  size_t task_args_size;
+
+  unsigned int generation;
+  int pending;
+  int shutdown;
+};
+
+struct stream_pool *stream_pool_create(const int nr_threads, const int *cpus);
+
+void stream_pool_run(struct stream_pool *pool, void *task(void *), void *args,
+                     const size_t args_size);
+
+void stream_pool_destroy(struct stream_pool *pool);
+
+int bind_thread_to_cpu(pthread_t thread, const int cpu);
+
+int create_bound_thread(pthread_t *thread, void *fun(void *), void *arg,
+                        const int cpu);
+
+/**
+ * Placement of the threads (or of the MPI ranks of a node) on the CPUs.
+ *
+ * none     threads are not pinned
+ * compact  fill the CPUs in topology order, SMT siblings first
+ * scatter  round robin over the sockets
+ * cores    one thread per physical core, SMT siblings are skipped
+ * CPULIST  explicit list of CPUs, i.e. 0-3,8,10-11
+ */
+#define BIND_POLICY_HELP                                                       \
+  "  --bind POLICY               CPU binding: none, compact, scatter, "        \
+  "cores or an\n"                                                              \
+  "                              explicit cpulist (i.e. 0-3,8).\n"
+
+#define MEMBIND_HELP                                                           \
+  "  --membind NODE              Allocate the vectors on the given NUMA "      \
+  "node.\n"
+
+int *make_cpu_binding(const char *policy, const int nr_threads);
+
+int *make_probe_cpu_binding(const char *policy, const int nr_threads);
+
+void print_cpu_binding(const char *policy, const int *cpus,
+                       const int nr_threads);
+
+/**
+ * Store policy of the kernels, selected with --store.
+ */
+#define STORE_REGULAR 1
+#define STORE_NT 2
+#define STORE_BOTH (STORE_REGULAR | STORE_NT)
+
+#define STORE_HELP                                                             \
+  "  --store MODE                regular (default), nt (non-temporal "         \
+  "stores) or both.\n"
+
+int parse_store_mode(const char *arg);
+
+#define THREADS_HELP                                                           \
+  "  --threads N                 Number of threads, default: all the CPUs.\n"
+
+int parse_cpulist(const char *list, int **cpus);
+
+int parse_thread_list(const char *arg, int **threads);
+
+int nr_allowed_cpus(void);
+
+int cpu_to_numa_node(const int cpu);
+
+int set_preferred_numa_node(const int node);
+
+int numa_nodes(int **nodes);
+
+int numa_node_cpus(const int node, int **cpus);
+
+/**
+ * Backing pages of the mmap allocations.
+ *
+ * default  regular allocation, THP as configured by the system
+ * 4k       4 KiB pages (MADV_NOHUGEPAGE)
+ * thp      transparent huge pages (MADV_HUGEPAGE)
+ * 2m, 1g   hugetlbfs pages (MAP_HUGETLB), falling back to THP
+ */
+#define PAGES_DEFAULT 0
+#define PAGES_4K 1
+#define PAGES_THP 2
+#define PAGES_2M 3
+#define PAGES_1G 4
+
+#define PAGES_HELP                                                             \
+  "  --pages MODE                Backing pages: 4k, thp, 2m or 1g "           \
+  "(hugetlbfs,\n"                                                          \
+  "                              thp if no huge page is reserved).\n"
+
+int parse_page_mode(const char *arg);
+
+const char *page_mode_name(const int mode);
+
+void *stream_mmap_alloc(const size_t bytes, const int node, const int pages);
+
+/**
+ * Pages actually backing a mapping, as reported by /proc/self/smaps.
+ */
+struct page_info {
+  size_t mapping_bytes;
+  size_t page_bytes;
+  size_t thp_bytes;
+};
+
+int read_page_info(const void *ptr, struct page_info *info);
+
+const char *describe_pages(const void *ptr, char *buffer, const size_t len);
+
+int stream_mmap_free(void *ptr);
+
+/**
+ * Reusable sense-reversing spin barrier used as start gate of the timed
+ * regions: the last thread arriving flips the generation and releases all
+ * the others at once.
+ */
+struct stream_barrier {
+  int nr_threads;
+  int count;
+  unsigned int generation;
+};
+
+void stream_barrier_init(struct stream_barrier *barrier, const int nr_threads);
+
+void stream_barrier_wait(struct stream_barrier *barrier);
+
+/**
+ * Spread of the start and end clocks of the threads over the repetitions.
+ */
+struct skew_stats {
+  double start_sum;
+  double start_max;
+  double end_sum;
+  double end_max;
+  int n;
+};
+
+double timespec_spread(const struct timespec *stamps, const int n);
+
+void skew_stats_add(struct skew_stats *stats, const struct timespec *start,
+                    const struct timespec *end, const int n);
+
+double skew_stats_start_mean(const struct skew_stats *stats);
+
+double skew_stats_end_mean(const struct skew_stats *stats);
+
+/**
+ * Randomised cyclic pointer chain, one pointer per cache line, for the
+ * latency probes.
+ */
+#define CACHE_LINE_SIZE 64
+
+size_t make_pointer_chain(void *buffer, const size_t bytes, unsigned int seed);
+
+void *chase_pointers(void *chain, const size_t loads);
+
+/**
+ * Random access updates (GUPS): table[r >> (31 - table_bits)] ^= r, with r
+ * drawn from generate_random_number, batch independent sequences in flight.
+ */
+#define GUPS_MAX_BATCH 64
+
+#define GUPS_HELP                                                              \
+  "  --gups                      Random access (XOR updates) on a table, "    \
+  "batches of\n"                                                               \
+  "                              1 to 64 updates in flight, in GUP/s.\n"       \
+  "  --gups-size BYTES           Table size, rounded down to a power of two, " \
+  "default\n"                                                                  \
+  "                              the size of the four vectors.\n"
+
+void gups_update(uint64_t *table, const int table_bits, const size_t updates,
+                 const int batch, const unsigned int seed);
+
+int gups_table_bits(const size_t bytes);
+
+/**
+ * Timings of a test in ms, one sample per repetition and thread (or rank).
+ * The first warmup repetitions are recorded but left out of the statistics.
+ */
+struct stream_samples {
+  int nr_threads;
+  int nr_repetitions;
+  int warmup;
+  double *clock; // [thread * nr_repetitions + repetition]
+};
+
+#define WARMUP_HELP                                                            \
+  "  --warmup K                  Repetitions dropped from the statistics, "    \
+  "default 1.\n"
+
+#define DEFAULT_WARMUP 1
+
+struct stream_samples *stream_samples_create(const int nr_threads,
+                                             const int nr_repetitions,
+                                             const int warmup);
+
+void stream_samples_set(struct stream_samples *samples, const int thread,
+                        const int repetition, const double clock);
+
+void stream_samples_free(struct stream_samples *samples);
+
+/**
+ * Distribution of the repetition times, a repetition time is the mean of its
+ * threads. Outliers are the samples with a modified z-score (based on the
+ * median absolute deviation) above 3.5.
+ */
+struct sample_stats {
+  int n;
+  double mean;
+  double min;
+  double median;
+  double p90;
+  double p99;
+  double max;
+  double std_dev;
+  double mad;
+  int outliers;
+};
+
+void sample_stats_compute(const double *v, const int n,
+                          struct sample_stats *stats);
+
+void stream_samples_stats(const struct stream_samples *samples,
+                          struct sample_stats *stats);
+
+void print_sample_stats_header(const int warmup);
+
+void print_sample_stats(const char *label, const struct sample_stats *stats,
+                        const double bytes);
 
 #endif // __MY_STREAM_UTILS__
\ No newline at end of file